@@ -1,130 +1,3374 @@
-// x-run: ~/scripts/runc.sh % -lraylib -lpthread
+// x-run: ~/scripts/runc.sh % -lraylib -ltcc -lpthread -lm -lz
+#include <assert.h>
 #include <stdint.h>
+#include <math.h>
 #include <raylib.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <pthread.h>
 #include <string.h>
 #include <unistd.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <zlib.h>
+#include <libtcc.h>
 
-#define WORLD_WIDTH 1366
-#define WORLD_HEIGHT 768
+#define DEFAULT_WIDTH 1366
+#define DEFAULT_HEIGHT 768
+#define HUGE_PAGE_SIZE (2 << 20)
+#define CHECKPOINT_MAGIC "RGBGENE\0"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_DATA 4096 // grid starts on its own page
+#define EXPORT_STRIP_ROWS 128
+#define ENSEMBLE_THUMB 256
+#define ENSEMBLE_GAP 2
+#define CAPTURE_QUEUE 4
+#define TIMELINE_MAGIC "RGBGTML\0"
+#define TIMELINE_VERSION 1
+#define TIMELINE_QUEUE 4
+#define TIMELINE_BLOCK 64 // rounds per compressed delta block
+#define TIMELINE_KEYFRAME_EVERY 1024 // default rounds between keyframes
+#define SHM_MAGIC "RGBGSHM\0"
+#define SHM_VERSION 1
+#define YUV_LANES 16
+#define MAX_LEVELS 16
+#define MIP_MIN_SIZE 512 // coarsest mip level fits in this
+#define PLOT_SAMPLES 196 // one per pixel of the panel
+#define PLOT_INTERVAL 0.1
 
-#define W_GET(ARR, X, Y) (((X) < 0 || (Y) < 0 || (X) >= WORLD_WIDTH || (Y) >= WORLD_HEIGHT) ? (union color_rgb565){ .color = 0 } : ARR[(X) + (Y) * WORLD_WIDTH])
+// World is split into tiles which are processed in checkerboard phases: during
+// a phase no two active tiles touch, so W_SET into a neighbour can't race.
+// That's four phases, up to nine when wrapping an odd number of tiles
+#define TILE_SIZE 64
+#define MAX_PHASES 9
+#define TILE_STEPS 256
+#define MAX_THREADS 256
+#define MAX_PROCS 64
+#define SNAP_FRESH 4
+#define PUBLISH_INTERVAL (1.0 / 240.0)
+#define PACE_SLACK 0.25 // seconds behind schedule before pacing gives up catching up
+#define PERF_BUCKETS 32 // log2 nanoseconds, the last one takes everything from ~2 s
+#define PERF_SLOTS (MAX_THREADS + 8)
+
+// Storage order of the colour grid, picked at build time with -DWORLD_LAYOUT=.
+// Cells are always named by their row-major index (frontier lists, RNG keys,
+// the hash), only where their colour lives in memory changes
+#define LAYOUT_ROWS 0   // row-major
+#define LAYOUT_BLOCKS 1 // 8x8 blocks, row-major inside and out: 3 rows fit in 2 cache lines
+#define LAYOUT_MORTON 2 // Z-order inside each engine tile, tiles row-major
+#ifndef WORLD_LAYOUT
+#define WORLD_LAYOUT LAYOUT_ROWS
+#endif
+#define BLOCK_SIZE 8
+
+#define DEFAULT_SEED 548392265
+#define MUTATE_CHANCE 13107 // 20% of 65536
+#define MUTATE_LANES 16
+#define RULE_CHECK_INTERVAL 0.5
+// In random mode a cell born during a round is picked later in it at a
+// random time, in a sweep it's picked when the sweep gets to it, which lets
+// growth chain further ahead. Scaling their chance by this brings sweep
+// occupancy within 0.5% of random mode over a whole run (measured, 12 seeds)
+#define SWEEP_BORN_CHANCE 0.86
+#define GROW_ALL 0x1EF // every neighbour, bit (ox + 1) + (oy + 1) * 3
+
+// Streams of the counter-based RNG, mixed into the low bits of the key
+enum rng_stream {
+  RNG_MUTATE = 0, // 0..7, one per neighbour slot
+  RNG_PICK = 8,
+  RNG_SEED = 9,
+  RNG_RULE = 10,
+  RNG_SWEEP = 11,
+  RNG_ROUND = 12,
+};
+
+enum engine_mode {
+  ENGINE_RANDOM,   // uniform picks over the whole tile
+  ENGINE_FRONTIER, // picks only among live cells that may still have room
+  ENGINE_SWEEP,    // walks each tile in order, accepting cells at random
+};
+
+// (X, Y) has to be inside the world: the ghost border of the occupancy plane
+// has already resolved neighbours outside it, or wrapped them around
 #define W_SET(ARR, X, Y, VAL) { \
-  if ((X) >= 0 && (Y) >= 0 && (X) < WORLD_WIDTH && (Y) < WORLD_HEIGHT) { \
-    ARR[(X) + (Y) * WORLD_WIDTH].color = VAL.color;\
-  }\
+  ARR[cell_index(X, Y)].color = VAL.color;\
+  tile_mark_dirty((X) / TILE_SIZE + ((Y) / TILE_SIZE) * world.tiles_x);\
 }
 
+// Same bit layout as GL_UNSIGNED_SHORT_5_6_5 (red in the top bits), so the
+// world can be uploaded as a PIXELFORMAT_UNCOMPRESSED_R5G6B5 texture as is
 union color_rgb565 {
   uint16_t color;
   struct rgb565 {
-    uint16_t r : 5;
-    uint16_t g : 6;
     uint16_t b : 5;
+    uint16_t g : 6;
+    uint16_t r : 5;
   } rgb;
 };
 
 struct v2i { int x, y; };
 
+struct cell_list {
+  int *cells;
+  int n, cap;
+};
+
+typedef uint16_t u16xN __attribute__((vector_size(MUTATE_LANES * sizeof(uint16_t))));
+typedef uint64_t u64xN __attribute__((vector_size(MUTATE_LANES * sizeof(uint64_t))));
+typedef int32_t i32xY __attribute__((vector_size(YUV_LANES * sizeof(int32_t))));
+typedef uint8_t u8xY __attribute__((vector_size(YUV_LANES)));
+
+// Picked cells whose empty neighbours have been claimed but not painted yet.
+// Lane l grows cells[l] into targets[l][0..n_targets[l]), -1 targets are
+// outside the world (never with wrap on): they still take a mutation step,
+// like the bounds-checked W_SET used to
+struct grow_batch {
+  int tile, n, grown, requeued;
+  int cells[MUTATE_LANES];
+  int n_targets[MUTATE_LANES];
+  int targets[MUTATE_LANES][8];
+  uint16_t colors[MUTATE_LANES];
+  struct worker *worker;
+};
+
+// Cells a worker painted during one round as index << 16 | color, in paint
+// order, and where each phase ended: replaying phase by phase and worker by
+// worker gives every cell its final colour for the round
+struct delta_log {
+  uint64_t *cells;
+  int n, cap;
+  int phase_end[MAX_PHASES];
+};
+
+// Live cells and how many of them have each red, green and blue value. The
+// workers count what they paint into their own copy during a round and the
+// leader adds those up after it, so nothing ever rescans the grid
+struct color_stats {
+  int64_t occupied;
+  int64_t r[32], g[64], b[32];
+};
+
+// What a strip has to tell its neighbours after a phase, see strip_exchange()
+struct strip_log {
+  struct delta_log cells; // painted in the rows either side of a strip boundary
+  struct cell_list born; // (source tile, cell) pairs claimed in a neighbour's tiles
+};
+
+// Checkpoint file: this header, then the raw RGB565 grid at CHECKPOINT_DATA.
+// The grid is the live world mapping, so the file may run ahead of `step`
+// between saves; `clean` tells whether it matches
+struct checkpoint {
+  char magic[8];
+  uint32_t version, clean;
+  int32_t width, height;
+  uint32_t mode, wrap;
+  uint64_t seed, step;
+  uint32_t layout; // WORLD_LAYOUT of the grid
+};
+
 struct world {
-  union color_rgb565 prev[WORLD_WIDTH * WORLD_HEIGHT];
-  union color_rgb565 curr[WORLD_WIDTH * WORLD_HEIGHT];
+  int width, height;
+  int tiles_x, tiles_y, n_tiles, n_dirty_words;
+  bool hugepages;
+
+  union color_rgb565 *curr;
+
+  // Occupancy plane, one bit per live or claimed cell, with a one cell empty
+  // border so a 3x3 window never needs bounds checks. Row y of the world is
+  // row y + 1 here, column x is bit x + 1. With wrap on, the border mirrors
+  // the opposite edges instead of staying empty. The pending plane has the same
+  // layout and marks cells claimed by a grow batch that hasn't been flushed
+  atomic_uint_fast64_t *occ, *pending;
+  int occ_stride; // words per row
+
+  const char *checkpoint_path;
+  struct checkpoint *checkpoint;
+  size_t checkpoint_size;
+
+  struct color_stats stats; // as of the last round
+
+  // Set in a strip process (--procs): it runs the tiles of rows [y0, y1)
+  struct {
+    bool split;
+    int y0, y1;
+  } strip;
+
+  // One bit per tile written since the last published snapshot
+  atomic_uint_fast64_t *dirty;
+
+  // Triple-buffered snapshots: the sim fills its back buffer and swaps it
+  // into `latest`, the renderer swaps its front buffer out when `latest` is
+  // fresh. Buffers are tile-major and every tile is stamped with the publish
+  // sequence it was copied at, so both sides only touch changed tiles
+  struct snapshots {
+    struct snapshot {
+      uint64_t seq, step;
+      uint64_t painted; // cells the workers have painted, as of this snapshot
+      struct color_stats stats;
+      uint64_t *tile_seq;
+      union color_rgb565 (*tiles)[TILE_SIZE * TILE_SIZE];
+    } buffers[3];
+    bool enabled; // something reads them: a window or --shm
+    atomic_int latest;
+    int back, front;
+    uint64_t seq, *tile_seq;
+    double last_publish;
+    atomic_uint_fast64_t n_published, n_skipped;
+    uint64_t n_consumed, n_reused;
+    uint64_t *uploaded_seq;
+  } snap;
 
-  RenderTexture rtex;
   pthread_mutex_t mut_world;
+
+  struct engine {
+    int n_threads;
+    enum engine_mode mode;
+    uint64_t seed, step;
+    uint64_t max_steps; // 0 runs forever
+    bool done;
+    bool wrap; // toroidal world, edges are neighbours of the opposite edges
+    // Pacing: the leader sleeps on `wake` between rounds to hold `rate`
+    // rounds per second (0 is unthrottled), and parks on it while paused or
+    // saturated. Anything that changes those bumps `generation`
+    pthread_mutex_t mut_pace;
+    pthread_cond_t wake;
+    double rate, pace_time;
+    uint64_t pace_step, generation, pace_generation;
+    bool fast_forward, paused, parked;
+    pthread_t threads[MAX_THREADS];
+    pthread_barrier_t barrier;
+    int n_phases;
+    int *phase_tiles[MAX_PHASES];
+    int n_phase_tiles[MAX_PHASES];
+    atomic_int next_tile[MAX_PHASES];
+    // Frontier mode: cells born into a tile but not grown from yet. Cells
+    // born from a neighbouring tile go to the inbox slot of that direction,
+    // which has a single writer, and are merged when the tile is processed
+    struct tile {
+      struct cell_list frontier;
+      struct cell_list inbox[9];
+    } *tiles;
+    atomic_long n_frontier;
+    struct worker {
+      atomic_uint_fast64_t n_steps, n_grown;
+      struct delta_log *log; // set by the leader for each round, NULL unless recording a timeline
+      struct strip_log *halo; // NULL unless the world is split into strips
+      struct color_stats stats; // painted this round
+    } __attribute__((aligned(64))) workers[MAX_THREADS];
+  } engine;
 } world = {
-  .mut_world = PTHREAD_MUTEX_INITIALIZER
+  .width = DEFAULT_WIDTH,
+  .height = DEFAULT_HEIGHT,
+  .mut_world = PTHREAD_MUTEX_INITIALIZER,
+  .engine.mut_pace = PTHREAD_MUTEX_INITIALIZER,
+  .engine.n_threads = 1,
+  .engine.seed = DEFAULT_SEED,
+  .snap.back = 0,
+  .snap.latest = 1,
+  .snap.front = 2,
 };
 
+static inline uint32_t morton_spread(uint32_t v) {
+  v = (v | (v << 8)) & 0x00FF00FF;
+  v = (v | (v << 4)) & 0x0F0F0F0F;
+  v = (v | (v << 2)) & 0x33333333;
+  v = (v | (v << 1)) & 0x55555555;
+  return v;
+}
+
+static inline size_t cell_index(int x, int y) {
+#if WORLD_LAYOUT == LAYOUT_BLOCKS
+  int blocks_x = (world.width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+  return ((size_t)(y / BLOCK_SIZE) * blocks_x + x / BLOCK_SIZE) * (BLOCK_SIZE * BLOCK_SIZE) + (y % BLOCK_SIZE) * BLOCK_SIZE + x % BLOCK_SIZE;
+#elif WORLD_LAYOUT == LAYOUT_MORTON
+  int tiles_x = (world.width + TILE_SIZE - 1) / TILE_SIZE;
+  return ((size_t)(y / TILE_SIZE) * tiles_x + x / TILE_SIZE) * (TILE_SIZE * TILE_SIZE) + (morton_spread(x % TILE_SIZE) | morton_spread(y % TILE_SIZE) << 1);
+#else
+  return x + (size_t)y * world.width;
+#endif
+}
+
+// Cells in the grid, with the padding the layout rounds up to
+size_t world_cells(void) {
+#if WORLD_LAYOUT == LAYOUT_BLOCKS
+  return (size_t)((world.width + BLOCK_SIZE - 1) / BLOCK_SIZE) * ((world.height + BLOCK_SIZE - 1) / BLOCK_SIZE) * BLOCK_SIZE * BLOCK_SIZE;
+#elif WORLD_LAYOUT == LAYOUT_MORTON
+  return (size_t)((world.width + TILE_SIZE - 1) / TILE_SIZE) * ((world.height + TILE_SIZE - 1) / TILE_SIZE) * TILE_SIZE * TILE_SIZE;
+#else
+  return (size_t)world.width * world.height;
+#endif
+}
+
+// Copies n cells of row y starting at x into dst, in row-major order
+void world_read_row(int x, int y, int n, union color_rgb565 *dst) {
+#if WORLD_LAYOUT == LAYOUT_ROWS
+  memcpy(dst, &world.curr[cell_index(x, y)], n * sizeof(union color_rgb565));
+#elif WORLD_LAYOUT == LAYOUT_BLOCKS
+  for (int i = 0; i < n;) {
+    int run = BLOCK_SIZE - (x + i) % BLOCK_SIZE;
+    if (run > n - i) run = n - i;
+    memcpy(&dst[i], &world.curr[cell_index(x + i, y)], run * sizeof(union color_rgb565));
+    i += run;
+  }
+#else
+  // Steps the spread x bits along the row instead of re-spreading each one
+  for (int i = 0; i < n;) {
+    int run = TILE_SIZE - (x + i) % TILE_SIZE;
+    if (run > n - i) run = n - i;
+    const union color_rgb565 *tile = &world.curr[cell_index(x + i - (x + i) % TILE_SIZE, y)];
+    uint32_t sx = morton_spread((x + i) % TILE_SIZE);
+    for (int k = 0; k < run; k++, sx = ((sx | 0xAAAAAAAA) + 1) & 0x55555555)
+      dst[i + k] = tile[sx];
+    i += run;
+  }
+#endif
+}
+
+// Copies the tw x th rectangle at (x0, y0) into dst, row-major. A whole
+// Z-order tile goes 2x2 quads at a time, which are 4 adjacent cells
+void world_read_rect(int x0, int y0, int tw, int th, union color_rgb565 *dst) {
+#if WORLD_LAYOUT == LAYOUT_MORTON
+  if (x0 % TILE_SIZE == 0 && y0 % TILE_SIZE == 0 && tw == TILE_SIZE && th == TILE_SIZE) {
+    const union color_rgb565 *tile = &world.curr[cell_index(x0, y0)];
+    for (int y = 0; y < TILE_SIZE; y += 2) {
+      uint32_t sy = morton_spread(y / 2) << 1, sx = 0;
+      for (int x = 0; x < TILE_SIZE; x += 2, sx = ((sx | 0xAAAAAAAA) + 1) & 0x55555555) {
+        union color_rgb565 q[4];
+        memcpy(q, &tile[(sx | sy) * 4], sizeof(q));
+        dst[x + y * TILE_SIZE] = q[0];
+        dst[x + 1 + y * TILE_SIZE] = q[1];
+        dst[x + (y + 1) * TILE_SIZE] = q[2];
+        dst[x + 1 + (y + 1) * TILE_SIZE] = q[3];
+      }
+    }
+    return;
+  }
+#endif
+  for (int y = 0; y < th; y++)
+    world_read_row(x0, y0 + y, tw, &dst[y * tw]);
+}
+
+double time_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Lock timing histograms. Every thread counts into its own slot, which has a
+// single writer so a relaxed load and store is enough, and the HUD merges
+// all slots once per frame. Threads past PERF_SLOTS share the last slot,
+// which is counted atomically instead
+static struct perf {
+  struct perf_slot {
+    atomic_uint_fast64_t wait[PERF_BUCKETS], hold[PERF_BUCKETS];
+  } __attribute__((aligned(64))) slots[PERF_SLOTS];
+  atomic_int n_slots;
+} perf;
+
+static _Thread_local struct perf_slot *perf_self;
+static _Thread_local double perf_locked_at;
+
+static inline int perf_bucket(double seconds) {
+  uint64_t ns = seconds > 0 ? seconds * 1e9 : 0;
+  int b = ns ? 64 - __builtin_clzll(ns) : 0;
+  return b < PERF_BUCKETS ? b : PERF_BUCKETS - 1;
+}
+
+static inline void perf_count(atomic_uint_fast64_t *c) {
+  if (perf_self == &perf.slots[PERF_SLOTS - 1])
+    atomic_fetch_add_explicit(c, 1, memory_order_relaxed);
+  else
+    atomic_store_explicit(c, atomic_load_explicit(c, memory_order_relaxed) + 1, memory_order_relaxed);
+}
+
+void world_lock(void) {
+  if (perf_self == NULL) {
+    int i = atomic_fetch_add(&perf.n_slots, 1);
+    perf_self = &perf.slots[i < PERF_SLOTS ? i : PERF_SLOTS - 1];
+  }
+  double start = time_now();
+  pthread_mutex_lock(&world.mut_world);
+  perf_locked_at = time_now();
+  perf_count(&perf_self->wait[perf_bucket(perf_locked_at - start)]);
+}
+
+void world_unlock(void) {
+  perf_count(&perf_self->hold[perf_bucket(time_now() - perf_locked_at)]);
+  pthread_mutex_unlock(&world.mut_world);
+}
+
+// Big buffers come straight from mmap so they can sit on huge pages, which
+// matters for the TLB with random access over a multi-gigabyte world. *size
+// comes back as the length actually mapped, whole huge pages for hugetlb
+void *world_map(size_t *size) {
+  void *p = MAP_FAILED;
+  if (world.hugepages) {
+    size_t huge = (*size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    p = mmap(NULL, huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p == MAP_FAILED) {
+      perror("mmap(MAP_HUGETLB), falling back to THP");
+      world.hugepages = false;
+    } else {
+      *size = huge;
+    }
+  }
+  if (p == MAP_FAILED) {
+    p = mmap(NULL, *size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+      perror("mmap");
+      exit(1);
+    }
+    if (*size >= HUGE_PAGE_SIZE) madvise(p, *size, MADV_HUGEPAGE);
+  }
+  return p;
+}
+
+void *world_alloc(size_t size) {
+  return world_map(&size);
+}
+
+// Frees a world_map() buffer, `mapped` being the length it returned
+void world_free(void *p, size_t mapped) {
+  if (munmap(p, mapped) < 0)
+    perror("munmap");
+}
+
+// Maps the checkpoint file and uses it as the world grid. Resuming takes the
+// world size, seed and step from the header; the pages fault in on demand
+bool checkpoint_open(const char *path, bool resume) {
+  struct checkpoint hdr = { 0 };
+  int fd = open(path, resume ? O_RDWR : O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(path);
+    return false;
+  }
+
+  if (resume) {
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || memcmp(hdr.magic, CHECKPOINT_MAGIC, 8) || hdr.version != CHECKPOINT_VERSION) {
+      fprintf(stderr, "%s: not a rgbgene checkpoint\n", path);
+      close(fd);
+      return false;
+    }
+    if (hdr.layout != WORLD_LAYOUT) {
+      fprintf(stderr, "%s: saved with WORLD_LAYOUT=%u, this build uses %d\n", path, hdr.layout, WORLD_LAYOUT);
+      close(fd);
+      return false;
+    }
+    if (hdr.width < 1 || hdr.height < 1 || (int64_t)hdr.width * hdr.height > INT32_MAX || hdr.mode > ENGINE_SWEEP) {
+      fprintf(stderr, "%s: bad header (%dx%d, mode %u)\n", path, hdr.width, hdr.height, hdr.mode);
+      close(fd);
+      return false;
+    }
+    if (!hdr.clean)
+      fprintf(stderr, "%s: wasn't saved cleanly, grid may be ahead of step %lu\n", path, hdr.step);
+    world.width = hdr.width;
+    world.height = hdr.height;
+    world.engine.seed = hdr.seed;
+    world.engine.step = hdr.step;
+    world.engine.mode = hdr.mode;
+    world.engine.wrap = hdr.wrap;
+  }
+
+  world.checkpoint_size = CHECKPOINT_DATA + world_cells() * sizeof(union color_rgb565);
+  if (!resume && ftruncate(fd, world.checkpoint_size) < 0) {
+    perror(path);
+    close(fd);
+    return false;
+  }
+  // A short file would only fault (SIGBUS) once the grid is touched
+  struct stat st;
+  if (resume && (fstat(fd, &st) < 0 || (size_t)st.st_size < world.checkpoint_size)) {
+    fprintf(stderr, "%s: truncated, %dx%d needs %zu bytes\n", path, world.width, world.height, world.checkpoint_size);
+    close(fd);
+    return false;
+  }
+
+  void *base = mmap(NULL, world.checkpoint_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    perror(path);
+    return false;
+  }
+
+  world.checkpoint_path = path;
+  world.checkpoint = base;
+  world.curr = (union color_rgb565 *)((uint8_t *)base + CHECKPOINT_DATA);
+  if (!resume) {
+    memcpy(world.checkpoint->magic, CHECKPOINT_MAGIC, 8);
+    world.checkpoint->version = CHECKPOINT_VERSION;
+    world.checkpoint->width = world.width;
+    world.checkpoint->height = world.height;
+    world.checkpoint->layout = WORLD_LAYOUT;
+  }
+  return true;
+}
+
+// Has to be called with mut_world held; only the pages written since the
+// last save go to disk
+void checkpoint_save(void) {
+  double start = time_now();
+  world.checkpoint->seed = world.engine.seed;
+  world.checkpoint->step = world.engine.step;
+  world.checkpoint->mode = world.engine.mode;
+  world.checkpoint->wrap = world.engine.wrap;
+  world.checkpoint->clean = 1;
+  if (msync(world.checkpoint, world.checkpoint_size, MS_SYNC) < 0) {
+    perror(world.checkpoint_path);
+    return;
+  }
+  printf("checkpoint: step %lu saved to %s in %.3fs\n", world.engine.step, world.checkpoint_path, time_now() - start);
+}
+
+void world_init(void) {
+  world.tiles_x = (world.width + TILE_SIZE - 1) / TILE_SIZE;
+  world.tiles_y = (world.height + TILE_SIZE - 1) / TILE_SIZE;
+  world.n_tiles = world.tiles_x * world.tiles_y;
+  world.n_dirty_words = (world.n_tiles + 63) / 64;
+
+  if (world.curr == NULL)
+    world.curr = world_alloc(world_cells() * sizeof(union color_rgb565));
+  world.dirty = calloc(world.n_dirty_words, sizeof(*world.dirty));
+  world.occ_stride = world.tiles_x + 1; // room for the 64 bits after any tile's first column
+  world.occ = world_alloc((size_t)world.occ_stride * (world.height + 2) * sizeof(*world.occ));
+  world.pending = world_alloc((size_t)world.occ_stride * (world.height + 2) * sizeof(*world.pending));
+
+  for (int i = 0; i < 3 && world.snap.enabled; i++) {
+    world.snap.buffers[i].tile_seq = calloc(world.n_tiles, sizeof(uint64_t));
+    world.snap.buffers[i].tiles = world_alloc((size_t)world.n_tiles * sizeof(*world.snap.buffers[i].tiles));
+  }
+  world.snap.tile_seq = calloc(world.n_tiles, sizeof(uint64_t));
+  world.snap.uploaded_seq = calloc(world.n_tiles, sizeof(uint64_t));
+
+  for (int p = 0; p < MAX_PHASES; p++)
+    world.engine.phase_tiles[p] = calloc(world.n_tiles, sizeof(int));
+  world.engine.tiles = calloc(world.n_tiles, sizeof(struct tile));
+}
+
+void cell_list_push(struct cell_list *l, int cell) {
+  if (l->n == l->cap) {
+    l->cap = l->cap ? l->cap * 2 : 64;
+    l->cells = realloc(l->cells, l->cap * sizeof(int));
+  }
+  l->cells[l->n++] = cell;
+}
+
+static inline void delta_log_push(struct delta_log *l, int cell, uint16_t color) {
+  if (l->n == l->cap) {
+    l->cap = l->cap ? l->cap * 2 : 4096;
+    l->cells = realloc(l->cells, l->cap * sizeof(uint64_t));
+  }
+  l->cells[l->n++] = (uint64_t)cell << 16 | color;
+}
+
+static inline void stats_paint(struct color_stats *s, union color_rgb565 from, union color_rgb565 to) {
+  if (from.color) {
+    s->occupied--;
+    s->r[from.rgb.r]--;
+    s->g[from.rgb.g]--;
+    s->b[from.rgb.b]--;
+  }
+  if (to.color) {
+    s->occupied++;
+    s->r[to.rgb.r]++;
+    s->g[to.rgb.g]++;
+    s->b[to.rgb.b]++;
+  }
+}
+
+void tile_bounds(int tile, int *x0, int *y0, int *tw, int *th) {
+  *x0 = (tile % world.tiles_x) * TILE_SIZE;
+  *y0 = (tile / world.tiles_x) * TILE_SIZE;
+  *tw = world.width - *x0 < TILE_SIZE ? world.width - *x0 : TILE_SIZE;
+  *th = world.height - *y0 < TILE_SIZE ? world.height - *y0 : TILE_SIZE;
+}
+
+static inline void tile_mark_dirty(int tile) {
+  atomic_uint_fast64_t *word = &world.dirty[tile / 64];
+  uint64_t bit = 1ull << (tile % 64);
+  if (!(atomic_load_explicit(word, memory_order_relaxed) & bit))
+    atomic_fetch_or_explicit(word, bit, memory_order_relaxed);
+}
+
+static inline int wrap_coord(int v, int n) {
+  return v < 0 ? v + n : v >= n ? v - n : v;
+}
+
+static inline bool strip_owns_row(int y) {
+  return !world.strip.split || (y >= world.strip.y0 && y < world.strip.y1);
+}
+
+// Sets or clears the bit of (x, y) in padded coordinates
+static inline void occ_bit(atomic_uint_fast64_t *plane, int px, int py, bool set) {
+  atomic_uint_fast64_t *word = &plane[(size_t)py * world.occ_stride + (px >> 6)];
+  if (set)
+    atomic_fetch_or_explicit(word, 1ull << (px & 63), memory_order_relaxed);
+  else
+    atomic_fetch_and_explicit(word, ~(1ull << (px & 63)), memory_order_relaxed);
+}
+
+// Copies an edge cell's bit into the ghost border on the opposite side,
+// corners included
+void occ_mirror(atomic_uint_fast64_t *plane, int x, int y, bool set) {
+  int px[2] = { x + 1 }, py[2] = { y + 1 }, nx = 1, ny = 1;
+  if (x == 0) px[nx++] = world.width + 1;
+  else if (x == world.width - 1) px[nx++] = 0;
+  if (y == 0) py[ny++] = world.height + 1;
+  else if (y == world.height - 1) py[ny++] = 0;
+  for (int i = 0; i < nx; i++)
+    for (int j = 0; j < ny; j++)
+      if (i || j) occ_bit(plane, px[i], py[j], set);
+}
+
+static inline void occ_set(atomic_uint_fast64_t *plane, int x, int y) {
+  occ_bit(plane, x + 1, y + 1, true);
+  if (world.engine.wrap && (x == 0 || y == 0 || x == world.width - 1 || y == world.height - 1))
+    occ_mirror(plane, x, y, true);
+}
+
+static inline void occ_clear(atomic_uint_fast64_t *plane, int x, int y) {
+  occ_bit(plane, x + 1, y + 1, false);
+  if (world.engine.wrap && (x == 0 || y == 0 || x == world.width - 1 || y == world.height - 1))
+    occ_mirror(plane, x, y, false);
+}
+
+// 3x3 occupancy around (x, y), bit (ox + 1) + (oy + 1) * 3 like GROW_ALL.
+// The window starts at padded column x, so it spans a word boundary only
+// when x % 64 > 61
+static inline int occ_window(const atomic_uint_fast64_t *plane, int x, int y) {
+  const atomic_uint_fast64_t *row = plane + (size_t)y * world.occ_stride + (x >> 6);
+  int s = x & 63, n = 0;
+  for (int r = 0; r < 3; r++, row += world.occ_stride) {
+    uint64_t bits = atomic_load_explicit(&row[0], memory_order_relaxed) >> s;
+    if (s > 61) bits |= atomic_load_explicit(&row[1], memory_order_relaxed) << (64 - s);
+    n |= (bits & 7) << (r * 3);
+  }
+  return n;
+}
+
+// 64 bits of a plane row starting at padded column px
+static inline uint64_t occ_bits(const atomic_uint_fast64_t *plane, int px, int py) {
+  const atomic_uint_fast64_t *w = plane + (size_t)py * world.occ_stride + (px >> 6);
+  int s = px & 63;
+  uint64_t v = atomic_load_explicit(&w[0], memory_order_relaxed) >> s;
+  if (s) v |= atomic_load_explicit(&w[1], memory_order_relaxed) << (64 - s);
+  return v;
+}
+
+// Bit k is set if cell (x0 + k, y) is occupied and has an empty neighbour
+static inline uint64_t occ_growable(int x0, int y) {
+  uint64_t full = ~0ull, self = 0;
+  for (int r = 0; r < 3; r++) {
+    uint64_t left = occ_bits(world.occ, x0, y + r), mid = occ_bits(world.occ, x0 + 1, y + r), right = occ_bits(world.occ, x0 + 2, y + r);
+    full &= left & right & (r == 1 ? ~0ull : mid);
+    if (r == 1) self = mid;
+  }
+  return self & ~full;
+}
+
 Color color_565rgb(union color_rgb565);
 union color_rgb565 color_rgb565(Color v);
-void mutate_color(union color_rgb565 *c) {
-  union color_rgb565 d = { .color = rand() & 0xFFFF };
+uint64_t mix64(uint64_t z) {
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  return z ^ (z >> 31);
+}
+
+// Counter-based generator: every number is a pure function of (seed, step,
+// key), so the result doesn't depend on which thread draws it or in what order
+static inline uint64_t rng_at(uint64_t seed, uint64_t step, uint64_t key) {
+  return mix64(mix64(seed + step * 0x9E3779B97F4A7C15ull) ^ key);
+}
+
+// rng_at() for MUTATE_LANES keys at once
+static inline void rng_at_lanes(uint64_t *rnd, uint64_t seed, uint64_t step, const uint64_t *keys) {
+  u64xN z;
+  memcpy(&z, keys, sizeof(z));
+  z ^= mix64(seed + step * 0x9E3779B97F4A7C15ull);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+  z ^= z >> 31;
+  memcpy(rnd, &z, sizeof(z));
+}
+
+static inline uint64_t rng_key(uint64_t index, enum rng_stream stream) {
+  return index << 4 | stream;
+}
+
+// Bits 0..15 are the delta, 16..63 the three 16-bit per-channel chances
+void mutate_color(union color_rgb565 *c, uint64_t rnd) {
+  union color_rgb565 d = { .color = rnd & 0xFFFF };
   d.rgb.r >>= 3;
   d.rgb.g >>= 4;
   d.rgb.b >>= 3;
 
-  if (rand() % 100 < 20) { c->rgb.r = c->rgb.r + d.rgb.r - 1; }
-  if (rand() % 100 < 20) { c->rgb.g = c->rgb.g + d.rgb.g - 2; }
-  if (rand() % 100 < 20) { c->rgb.b = c->rgb.b + d.rgb.b - 1; }
+  if (((rnd >> 16) & 0xFFFF) < MUTATE_CHANCE) { c->rgb.r = c->rgb.r + d.rgb.r - 1; }
+  if (((rnd >> 32) & 0xFFFF) < MUTATE_CHANCE) { c->rgb.g = c->rgb.g + d.rgb.g - 2; }
+  if (((rnd >> 48) & 0xFFFF) < MUTATE_CHANCE) { c->rgb.b = c->rgb.b + d.rgb.b - 1; }
 
 }
 
-void *world_update(void *_) {
+// Scalar reference for mutate_colors()
+void mutate_colors_ref(uint16_t *c, const uint64_t *rnd) {
+  for (int i = 0; i < MUTATE_LANES; i++) {
+    union color_rgb565 v = { .color = c[i] };
+    mutate_color(&v, rnd[i]);
+    c[i] = v.color;
+  }
+}
 
-  while (true) {
-    pthread_mutex_lock(&world.mut_world);
-    for (int j = 0; j < 1000; j++) {
-      int i = rand() % (WORLD_WIDTH * WORLD_HEIGHT);
-      int x = i % WORLD_WIDTH, y = i / WORLD_WIDTH;
-      union color_rgb565 c = world.curr[i];
-      if (c.color != 0) {
-        for (int ox = -1; ox <= 1; ox++) {
-          for (int oy = -1; oy <= 1; oy++) {
-            if (ox == 0 && oy == 0) continue;
-            /*if ((ox * ox + oy * oy) > 1) continue;*/
-            if (W_GET(world.curr, x + ox, y + oy).color != 0) continue;
-            mutate_color(&c);
-            W_SET(world.curr, x + ox, y + oy, c);
-          }
-        }
-        mutate_color(&c);
-        /*if (rand() % 100 <= 1)*/
-        /*  W_SET(world.curr, x, y, c);*/
-      }
+// mutate_color() on MUTATE_LANES colours at once: every channel is updated
+// in place in the packed word and then blended in under its chance mask
+__attribute__((target_clones("avx2", "default")))
+void mutate_colors(uint16_t *colors, const uint64_t *rnd) {
+  u16xN c, d, r, g, b;
+  u64xN rv;
+  memcpy(&c, colors, sizeof(c));
+  memcpy(&rv, rnd, sizeof(rv));
+
+  d = __builtin_convertvector(rv, u16xN);
+  u16xN mr = (u16xN)(__builtin_convertvector(rv >> 16, u16xN) < MUTATE_CHANCE) & 0xF800;
+  u16xN mg = (u16xN)(__builtin_convertvector(rv >> 32, u16xN) < MUTATE_CHANCE) & 0x07E0;
+  u16xN mb = (u16xN)(__builtin_convertvector(rv >> 48, u16xN) < MUTATE_CHANCE) & 0x001F;
+
+  r = c + ((((d >> 14) & 3) - 1) << 11);
+  g = (c & 0x07E0) + ((((d >> 9) & 3) - 2) << 5);
+  b = (c & 0x001F) + ((d >> 3) & 3) - 1;
+
+  c = (c & ~(mr | mg | mb)) | (r & mr) | (g & mg) | (b & mb);
+  memcpy(colors, &c, sizeof(c));
+}
+
+void mutate_colors_check(void) {
+  uint16_t a[MUTATE_LANES], b[MUTATE_LANES];
+  uint64_t rnd[MUTATE_LANES];
+  for (int j = 0; j < 4096; j++) {
+    for (int i = 0; i < MUTATE_LANES; i++) {
+      rnd[i] = rng_at(0, j, rng_key(i, RNG_MUTATE));
+      a[i] = b[i] = rng_at(1, j, rng_key(i, RNG_MUTATE)) & 0xFFFF;
     }
-    pthread_mutex_unlock(&world.mut_world);
-    usleep(1);
+    mutate_colors_ref(a, rnd);
+    mutate_colors(b, rnd);
+    assert(!memcmp(a, b, sizeof(a)));
   }
-  return NULL;
 }
 
-int main(void) {
-  InitWindow(WORLD_WIDTH, WORLD_HEIGHT, "rgbgene");
-  SetTargetFPS(60);
+// Growth rule compiled at runtime from a C file (--rule), which may export
+//   int grow(uint16_t color, uint64_t rnd)
+//     mask of the neighbours a picked cell grows into, GROW_ALL by default
+//   void mutate(int n, uint16_t *colors, const uint64_t *rnd)
+//     mutates n colours in place, one random word each, n is MUTATE_LANES
+// Either one falls back to the built-in rule when missing. The rule is only
+// swapped under mut_world, so a round always runs with a single rule
+static struct rule {
+  const char *path;
+  long mtime;
+  double last_check;
+  TCCState *tcc;
+  void *memory;
+  int (*grow)(uint16_t color, uint64_t rnd);
+  void (*mutate)(int n, uint16_t *colors, const uint64_t *rnd);
+} rule;
 
-  srand(548392265);
+void rule_error(void *opaque, const char *error) {
+  fprintf(stderr, "%s: %s\n", rule.path, error);
+}
 
-  world.rtex = LoadRenderTexture(WORLD_WIDTH, WORLD_HEIGHT);
+bool rule_load(void) {
+  struct rule next = { .path = rule.path, .mtime = GetFileModTime(rule.path) };
+  char *code = LoadFileText(rule.path);
+  int size;
 
-  for (int i = 0; i < 16; i++) {
-    world.curr[rand() % (WORLD_WIDTH * WORLD_HEIGHT)].color = rand() & 0xFFFF;
+  if (code == NULL) {
+    rule_error(NULL, "can't read");
+    return false;
+  }
+  if ((next.tcc = tcc_new()) == NULL) {
+    UnloadFileText(code);
+    return false;
+  }
+  tcc_set_error_func(next.tcc, NULL, rule_error);
+  tcc_set_output_type(next.tcc, TCC_OUTPUT_MEMORY);
+  tcc_add_library(next.tcc, "m");
+
+  if (-1 == tcc_compile_string(next.tcc, code) || (size = tcc_relocate(next.tcc, NULL)) < 0 ||
+      (next.memory = malloc(size)) == NULL || -1 == tcc_relocate(next.tcc, next.memory)) {
+    UnloadFileText(code);
+    tcc_delete(next.tcc);
+    free(next.memory);
+    rule.mtime = next.mtime; // don't retry until the file changes again
+    return false;
   }
+  UnloadFileText(code);
 
-  pthread_t thrd_world;
-  pthread_create(&thrd_world, NULL, world_update, NULL);
+  next.grow = tcc_get_symbol(next.tcc, "grow");
+  next.mutate = tcc_get_symbol(next.tcc, "mutate");
+  if (next.grow == NULL && next.mutate == NULL) {
+    rule_error(NULL, "exports neither grow nor mutate");
+    tcc_delete(next.tcc);
+    free(next.memory);
+    rule.mtime = next.mtime;
+    return false;
+  }
 
-  while (!WindowShouldClose()) {
-    BeginDrawing();
+  world_lock();
+  struct rule prev = rule;
+  next.last_check = rule.last_check;
+  rule = next;
+  world_unlock();
+
+  if (prev.tcc) tcc_delete(prev.tcc);
+  free(prev.memory);
+  printf("%s: loaded%s%s\n", rule.path, rule.grow ? " grow" : "", rule.mutate ? " mutate" : "");
+  return true;
+}
+
+// Recompiles the rule when its file changes, polled from the render loop
+void rule_reload(void) {
+  double now = time_now();
+  if (rule.path == NULL || now - rule.last_check < RULE_CHECK_INTERVAL) return;
+  rule.last_check = now;
+  if (GetFileModTime(rule.path) != rule.mtime)
+    rule_load();
+}
+
+// Only called for cells inside the world, from the tile that owns (x, y)
+void frontier_add(int tile, int x, int y) {
+  int tx = x / TILE_SIZE, ty = y / TILE_SIZE, t = tx + ty * world.tiles_x;
+  if (t == tile) {
+    cell_list_push(&world.engine.tiles[t].frontier, x + y * world.width);
+  } else {
+    int dx = tile % world.tiles_x - tx, dy = tile / world.tiles_x - ty;
+    if (dx > 1) dx -= world.tiles_x; else if (dx < -1) dx += world.tiles_x;
+    if (dy > 1) dy -= world.tiles_y; else if (dy < -1) dy += world.tiles_y;
+    cell_list_push(&world.engine.tiles[t].inbox[(dx + 1) + (dy + 1) * 3], x + y * world.width);
+  }
+}
+
+// Paints all claimed targets, one mutation step per neighbour slot across all
+// lanes. The k-th step of a lane uses the same key the scalar loop used, so
+// batching doesn't change the outcome
+void grow_batch_flush(struct grow_batch *b) {
+  uint64_t seed = world.engine.seed, step = world.engine.step;
+  struct worker *w = b->worker;
+  int max_targets = 0;
+  uint64_t keys[MUTATE_LANES], rnd[MUTATE_LANES];
+
+  for (int l = 0; l < b->n; l++) {
+    if (b->n_targets[l] > max_targets) max_targets = b->n_targets[l];
+  }
+
+  for (int k = 0; k < max_targets; k++) {
+    for (int l = 0; l < MUTATE_LANES; l++)
+      keys[l] = rng_key(l < b->n ? b->cells[l] : 0, RNG_MUTATE + k);
+    rng_at_lanes(rnd, seed, step, keys);
+    if (rule.mutate)
+      rule.mutate(MUTATE_LANES, b->colors, rnd);
+    else
+      mutate_colors(b->colors, rnd);
+    for (int l = 0; l < b->n; l++) {
+      if (k >= b->n_targets[l] || b->targets[l][k] < 0) continue;
+      int i = b->targets[l][k], x = i % world.width, y = i / world.width;
+      union color_rgb565 c = { .color = b->colors[l] };
+      stats_paint(&w->stats, world.curr[cell_index(x, y)], c);
+      W_SET(world.curr, x, y, c);
+      if (w->log) delta_log_push(w->log, i, c.color);
+      if (w->halo && (y <= world.strip.y0 || y >= world.strip.y1 - 1)) delta_log_push(&w->halo->cells, i, c.color);
+      if (b->colors[l] == 0) occ_clear(world.occ, x, y);
+      b->grown++;
+    }
+  }
+  for (int l = 0; l < b->n; l++) {
+    for (int k = 0; k < b->n_targets[l]; k++) {
+      int i = b->targets[l][k];
+      if (i >= 0) occ_clear(world.pending, i % world.width, i / world.width);
+    }
+  }
+  b->n = 0;
+}
+
+// Claims the empty neighbours of (x, y) for a new lane. Touching a cell that
+// is still claimed by this batch flushes it first, so the picks see exactly
+// what they would have seen if they had been grown one at a time (a cell
+// can mutate to black and become empty again). Empty picks and full
+// neighbourhoods are rejected from the bit planes alone
+void grow_batch_add(struct grow_batch *b, int x, int y) {
+  int i = x + y * world.width, l = b->n, n = 0, mask = GROW_ALL;
+  int occ = occ_window(world.occ, x, y);
+  uint16_t c;
+  bool held = false;
+
+  if (b->n > 0 && occ_window(world.pending, x, y)) {
+    grow_batch_flush(b);
+    l = 0;
+    occ = occ_window(world.occ, x, y);
+  }
+  if (!(occ & 0x10) || !(~occ & GROW_ALL)) return;
+  c = world.curr[cell_index(x, y)].color;
+  if (rule.grow)
+    mask = rule.grow(c, rng_at(world.engine.seed, world.engine.step, rng_key(i, RNG_RULE)));
+
+  for (int ox = -1; ox <= 1; ox++) {
+    for (int oy = -1; oy <= 1; oy++) {
+      if (ox == 0 && oy == 0) continue;
+      /*if ((ox * ox + oy * oy) > 1) continue;*/
+      if (occ >> ((ox + 1) + (oy + 1) * 3) & 1) continue;
+      int nx = x + ox, ny = y + oy;
+      if (world.engine.wrap) {
+        nx = wrap_coord(nx, world.width);
+        ny = wrap_coord(ny, world.height);
+      }
+      bool inside = nx >= 0 && ny >= 0 && nx < world.width && ny < world.height;
+      int j = nx + ny * world.width;
+      if (!(mask >> ((ox + 1) + (oy + 1) * 3) & 1)) {
+        held |= inside;
+        continue;
+      }
+      b->targets[l][n++] = inside ? j : -1;
+    }
+  }
+  // A cell the rule held back from an empty neighbour stays on the frontier
+  if (held && world.engine.mode == ENGINE_FRONTIER) {
+    frontier_add(b->tile, x, y);
+    b->requeued++;
+  }
+  if (n == 0) return;
+
+  for (int k = 0; k < n; k++) {
+    int j = b->targets[l][k];
+    if (j < 0) continue;
+    occ_set(world.occ, j % world.width, j / world.width);
+    occ_set(world.pending, j % world.width, j / world.width);
+    if (world.engine.mode != ENGINE_FRONTIER) continue;
+    if (b->worker->halo && !strip_owns_row(j / world.width)) {
+      cell_list_push(&b->worker->halo->born, b->tile);
+      cell_list_push(&b->worker->halo->born, j);
+    } else {
+      frontier_add(b->tile, j % world.width, j / world.width);
+    }
+  }
+
+  b->cells[l] = i;
+  b->colors[l] = c;
+  b->n_targets[l] = n;
+  if (++b->n == MUTATE_LANES) grow_batch_flush(b);
+}
+
+void world_update_tile(struct worker *self, int tile) {
+  int x0, y0, tw, th;
+  tile_bounds(tile, &x0, &y0, &tw, &th);
+  uint64_t seed = world.engine.seed, step = world.engine.step;
+  struct grow_batch b = { .tile = tile, .worker = self };
+
+  for (int j = 0; j < TILE_STEPS; j++) {
+    uint64_t r = rng_at(seed, step, rng_key((uint64_t)tile * TILE_STEPS + j, RNG_PICK));
+    int x = x0 + (((r & 0xFFFFFFFF) * tw) >> 32), y = y0 + (((r >> 32) * th) >> 32);
+    grow_batch_add(&b, x, y);
+  }
+  grow_batch_flush(&b);
+
+  atomic_fetch_add_explicit(&self->n_steps, TILE_STEPS, memory_order_relaxed);
+  atomic_fetch_add_explicit(&self->n_grown, b.grown, memory_order_relaxed);
+}
+
+// Visits the cells of the tile in order and picks each one with the chance
+// it has of being picked at least once by the TILE_STEPS uniform picks of
+// random mode, so growth per round matches while memory is read as a
+// stream. Only cells that can grow (live, with an empty neighbour) need the
+// coin flip, and those come 64 at a time out of the occupancy plane; the
+// row mask is only rebuilt after a pick has claimed something. The
+// direction flips every round in x and every other round in y so growth
+// has no bias. Cells born during the sweep can be reached again in the same
+// round, and get a lower chance for it, see SWEEP_BORN_CHANCE
+void world_update_tile_sweep(struct worker *self, int tile) {
+  int x0, y0, tw, th;
+  tile_bounds(tile, &x0, &y0, &tw, &th);
+  uint64_t seed = world.engine.seed, step = world.engine.step;
+  struct grow_batch b = { .tile = tile, .worker = self };
+  double p = 1 - pow(1 - 1.0 / (tw * th), TILE_STEPS);
+  uint64_t threshold = p < 1 ? (uint64_t)(p * 0x1p63) * 2 : UINT64_MAX;
+  uint64_t born_threshold = p * SWEEP_BORN_CHANCE < 1 ? (uint64_t)(p * SWEEP_BORN_CHANCE * 0x1p63) * 2 : UINT64_MAX;
+  uint64_t born[TILE_SIZE] = { 0 }; // cells claimed by this sweep, bit x - x0 of row y - y0
+  uint64_t row_mask = tw == 64 ? ~0ull : (1ull << tw) - 1;
+  bool flip_x = step & 1, flip_y = step & 2;
+  int n_steps = 0;
 
-    BeginTextureMode(world.rtex);
-    pthread_mutex_lock(&world.mut_world);
-    for (int y = 0; y < WORLD_HEIGHT; y++) {
-      for (int x = 0; x < WORLD_WIDTH; x++) {
-        int i = x + y * WORLD_WIDTH;
-        if (world.curr[i].color != world.prev[i].color) {
-          DrawPixel(x, y, color_565rgb(world.curr[i]));
+  for (int r = 0; r < th; r++) {
+    int y = y0 + (flip_y ? th - 1 - r : r);
+    uint64_t cand = occ_growable(x0, y) & row_mask;
+    while (cand) {
+      int cx = flip_x ? 63 - __builtin_clzll(cand) : __builtin_ctzll(cand);
+      uint64_t ahead = flip_x ? (1ull << cx) - 1 : ~0ull << cx << 1;
+      int x = x0 + cx;
+      cand &= ahead;
+      if (rng_at(seed, step, rng_key(x + (uint64_t)y * world.width, RNG_SWEEP)) > (born[y - y0] >> cx & 1 ? born_threshold : threshold)) continue;
+      n_steps++;
+      int grown = b.grown + b.n;
+      grow_batch_add(&b, x, y);
+      if (b.grown + b.n != grown) {
+        int l = (b.n ? b.n : MUTATE_LANES) - 1;
+        for (int k = 0; k < b.n_targets[l]; k++) {
+          int j = b.targets[l][k], tx = j % world.width - x0, ty = j / world.width - y0;
+          if (j >= 0 && tx >= 0 && ty >= 0 && tx < tw && ty < th) born[ty] |= 1ull << tx;
         }
+        cand = occ_growable(x0, y) & row_mask & ahead;
       }
     }
-    memcpy(world.prev, world.curr, sizeof(world.prev));
-    pthread_mutex_unlock(&world.mut_world);
-    EndTextureMode();
+  }
+  grow_batch_flush(&b);
 
-    if (IsKeyPressed(KEY_S)) {
-      Image img = LoadImageFromTexture(world.rtex.texture);
-      ExportImage(img, "rgbgene.png");
-      UnloadImage(img);
+  atomic_fetch_add_explicit(&self->n_steps, n_steps, memory_order_relaxed);
+  atomic_fetch_add_explicit(&self->n_grown, b.grown, memory_order_relaxed);
+}
+
+// Every frontier cell gets picked at the same average rate as a cell in
+// random mode (TILE_STEPS per tile area, the fraction rounded up or down at
+// random), and since a grown cell has filled all of its empty neighbours it
+// leaves the frontier for good
+void world_update_tile_frontier(struct worker *self, int tile) {
+  struct tile *t = &world.engine.tiles[tile];
+  uint64_t seed = world.engine.seed, step = world.engine.step;
+  struct grow_batch b = { .tile = tile, .worker = self };
+  int n_steps, rem, j;
+
+  for (int d = 0; d < 9; d++) {
+    for (int j = 0; j < t->inbox[d].n; j++)
+      cell_list_push(&t->frontier, t->inbox[d].cells[j]);
+    t->inbox[d].n = 0;
+  }
+
+  n_steps = t->frontier.n * TILE_STEPS / (TILE_SIZE * TILE_SIZE);
+  rem = t->frontier.n * TILE_STEPS % (TILE_SIZE * TILE_SIZE);
+  if (rem && ((rng_at(seed, step, rng_key(tile, RNG_ROUND)) & 0xFFFFFFFF) * (TILE_SIZE * TILE_SIZE) >> 32) < rem)
+    n_steps++;
+  for (j = 0; j < n_steps && t->frontier.n > 0; j++) {
+    uint64_t r = rng_at(seed, step, rng_key((uint64_t)tile * TILE_STEPS + j, RNG_PICK));
+    int slot = ((r & 0xFFFFFFFF) * t->frontier.n) >> 32, i = t->frontier.cells[slot];
+    t->frontier.cells[slot] = t->frontier.cells[--t->frontier.n];
+    grow_batch_add(&b, i % world.width, i / world.width);
+  }
+  grow_batch_flush(&b);
+
+  atomic_fetch_add_explicit(&world.engine.n_frontier, b.grown + b.requeued - j, memory_order_relaxed);
+  atomic_fetch_add_explicit(&self->n_steps, n_steps, memory_order_relaxed);
+  atomic_fetch_add_explicit(&self->n_grown, b.grown, memory_order_relaxed);
+}
+
+// Shared-memory frame export (--shm NAME, shows up as /dev/shm/NAME): this
+// header, then the dirty-tile bitmap, then the frame at data_offset as
+// row-major RGB565, width * 2 bytes per row. The leader rewrites the changed
+// tiles at every publish under a seqlock: seq is odd while a frame is being
+// written, so a reader copies what it needs between two reads of an even,
+// unchanged seq. Bit t of dirty is set for the tiles (t % tiles_x, t /
+// tiles_x) of tile_size cells changed in frame seq; a reader that saw an
+// older frame than seq - 2 has to take everything
+struct shm_header {
+  char magic[8];
+  uint32_t version, data_offset;
+  int32_t width, height, tile_size, tiles_x, tiles_y, dirty_words;
+  _Atomic uint64_t seq;
+  uint64_t step;
+  uint64_t dirty[];
+};
+
+static struct shm {
+  const char *name;
+  struct shm_header *hdr;
+  uint16_t *frame;
+  size_t size;
+} shm;
+
+bool shm_start(const char *name) {
+  size_t header = sizeof(struct shm_header) + world.n_dirty_words * sizeof(uint64_t);
+  size_t offset = (header + 4095) & ~(size_t)4095;
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    perror(name);
+    return false;
+  }
+  shm.size = offset + (size_t)world.width * world.height * sizeof(uint16_t);
+  if (ftruncate(fd, shm.size) < 0 || (shm.hdr = mmap(NULL, shm.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+    perror(name);
+    close(fd);
+    shm_unlink(name);
+    shm.hdr = NULL;
+    return false;
+  }
+  close(fd);
+
+  shm.name = name;
+  shm.frame = (uint16_t *)((uint8_t *)shm.hdr + offset);
+  *shm.hdr = (struct shm_header) {
+    .version = SHM_VERSION,
+    .data_offset = offset,
+    .width = world.width,
+    .height = world.height,
+    .tile_size = TILE_SIZE,
+    .tiles_x = world.tiles_x,
+    .tiles_y = world.tiles_y,
+    .dirty_words = world.n_dirty_words,
+    .step = world.engine.step,
+  };
+  for (int y = 0; y < world.height; y++)
+    world_read_row(0, y, world.width, (union color_rgb565 *)shm.frame + (size_t)y * world.width);
+  memset(shm.hdr->dirty, 0xFF, world.n_dirty_words * sizeof(uint64_t));
+  memcpy(shm.hdr->magic, SHM_MAGIC, 8); // last, readers wait for it
+  atomic_store_explicit(&shm.hdr->seq, 2, memory_order_release);
+  return true;
+}
+
+// Copies the tiles changed in snapshot `buf` (stamped with its seq) out of it
+void shm_publish(struct snapshot *buf) {
+  struct shm_header *h = shm.hdr;
+  uint64_t seq = atomic_load_explicit(&h->seq, memory_order_relaxed);
+
+  atomic_store_explicit(&h->seq, seq + 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_release);
+  memset(h->dirty, 0, world.n_dirty_words * sizeof(uint64_t));
+  for (int tile = 0; tile < world.n_tiles; tile++) {
+    if (buf->tile_seq[tile] != buf->seq) continue;
+    int x0, y0, tw, th;
+    tile_bounds(tile, &x0, &y0, &tw, &th);
+    for (int y = 0; y < th; y++)
+      memcpy(&shm.frame[x0 + (size_t)(y0 + y) * world.width], &buf->tiles[tile][y * tw], tw * sizeof(uint16_t));
+    h->dirty[tile / 64] |= 1ull << (tile % 64);
+  }
+  h->step = buf->step;
+  atomic_store_explicit(&h->seq, seq + 2, memory_order_release);
+}
+
+void shm_stop(void) {
+  if (shm.hdr == NULL) return;
+  munmap(shm.hdr, shm.size);
+  shm_unlink(shm.name);
+  shm.hdr = NULL;
+}
+
+// Called by the leader between rounds, while it's the only one touching curr
+void world_publish(bool force) {
+  struct snapshots *snap = &world.snap;
+  double now = time_now();
+  bool changed = false;
+
+  if (!snap->enabled || (!force && now - snap->last_publish < PUBLISH_INTERVAL)) return;
+
+  for (int w = 0; w < world.n_dirty_words; w++) {
+    uint64_t bits = atomic_exchange_explicit(&world.dirty[w], 0, memory_order_relaxed);
+    if (bits) changed = true;
+    for (; bits; bits &= bits - 1)
+      snap->tile_seq[w * 64 + __builtin_ctzll(bits)] = snap->seq + 1;
+  }
+  if (!changed) return;
+
+  struct snapshot *buf = &snap->buffers[snap->back];
+  snap->seq++;
+  for (int tile = 0; tile < world.n_tiles; tile++) {
+    if (snap->tile_seq[tile] <= buf->tile_seq[tile]) continue;
+    int x0, y0, tw, th;
+    tile_bounds(tile, &x0, &y0, &tw, &th);
+    world_read_rect(x0, y0, tw, th, buf->tiles[tile]);
+    buf->tile_seq[tile] = snap->tile_seq[tile];
+  }
+  buf->seq = snap->seq;
+  buf->step = world.engine.step;
+  buf->stats = world.stats;
+  buf->painted = 0;
+  for (int i = 0; i < world.engine.n_threads; i++)
+    buf->painted += atomic_load_explicit(&world.engine.workers[i].n_grown, memory_order_relaxed);
+  if (shm.hdr) shm_publish(buf);
+
+  int prev = atomic_exchange(&snap->latest, snap->back | SNAP_FRESH);
+  if (prev & SNAP_FRESH)
+    atomic_fetch_add_explicit(&snap->n_skipped, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&snap->n_published, 1, memory_order_relaxed);
+  snap->back = prev & ~SNAP_FRESH;
+  snap->last_publish = now;
+}
+
+// Renderer side: picks up the newest snapshot if there is one, otherwise
+// keeps using the one it already has
+struct snapshot *world_consume(void) {
+  struct snapshots *snap = &world.snap;
+  if (atomic_load(&snap->latest) & SNAP_FRESH) {
+    snap->front = atomic_exchange(&snap->latest, snap->front) & ~SNAP_FRESH;
+    snap->n_consumed++;
+  } else {
+    snap->n_reused++;
+  }
+  return &snap->buffers[snap->front];
+}
+
+// Time-lapse capture: the leader copies the grid into a free queue slot every
+// `every` steps and a writer thread converts and streams it as YUV4MPEG2.
+// With a full queue the frame is dropped, or with --capture-lossless the sim
+// waits for the writer (counted as a stall)
+static struct capture {
+  FILE *out;
+  bool is_pipe, lossless, stop;
+  uint64_t every;
+  pthread_t thread;
+  pthread_mutex_t mut;
+  pthread_cond_t cond;
+  uint16_t *frames[CAPTURE_QUEUE];
+  int head, n;
+  uint8_t *yuv;
+  atomic_uint_fast64_t n_written, n_dropped, n_stalls;
+} capture = {
+  .mut = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+  .every = 16,
+};
+
+// BT.601 limited range, 8.8 fixed point
+static inline void rgb565_to_yuv(uint16_t c, uint8_t *y, uint8_t *u, uint8_t *v) {
+  int r = (c >> 11) << 3, g = ((c >> 5) & 63) << 2, b = (c & 31) << 3;
+  *y = ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+  *u = ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+  *v = ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+// rgb565_to_yuv() over a row, YUV_LANES pixels at a time into planar output
+__attribute__((target_clones("avx2", "default")))
+void rgb565_to_yuv_row(const uint16_t *src, uint8_t *y, uint8_t *u, uint8_t *v, int n) {
+  int i = 0;
+  for (; i + YUV_LANES <= n; i += YUV_LANES) {
+    uint16_t px[YUV_LANES];
+    memcpy(px, src + i, sizeof(px));
+    i32xY c = { 0 };
+    for (int l = 0; l < YUV_LANES; l++) c[l] = px[l];
+    i32xY r = (c >> 11) << 3, g = ((c >> 5) & 63) << 2, b = (c & 31) << 3;
+    u8xY vy = __builtin_convertvector(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16, u8xY);
+    u8xY vu = __builtin_convertvector(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128, u8xY);
+    u8xY vv = __builtin_convertvector(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128, u8xY);
+    memcpy(y + i, &vy, YUV_LANES);
+    memcpy(u + i, &vu, YUV_LANES);
+    memcpy(v + i, &vv, YUV_LANES);
+  }
+  for (; i < n; i++)
+    rgb565_to_yuv(src[i], &y[i], &u[i], &v[i]);
+}
+
+void *capture_thread(void *_) {
+  size_t plane = (size_t)world.width * world.height;
+
+  while (true) {
+    pthread_mutex_lock(&capture.mut);
+    while (capture.n == 0 && !capture.stop)
+      pthread_cond_wait(&capture.cond, &capture.mut);
+    if (capture.n == 0) {
+      pthread_mutex_unlock(&capture.mut);
+      break;
     }
+    uint16_t *frame = capture.frames[capture.head];
+    pthread_mutex_unlock(&capture.mut);
 
-    {
-      ClearBackground(BLACK);
-      DrawTexture(world.rtex.texture, 0, 0, WHITE);
+    for (int y = 0; y < world.height; y++) {
+      size_t row = (size_t)y * world.width;
+      rgb565_to_yuv_row(frame + row, capture.yuv + row, capture.yuv + plane + row, capture.yuv + plane * 2 + row, world.width);
     }
-    EndDrawing();
+    fputs("FRAME\n", capture.out);
+    fwrite(capture.yuv, 1, plane * 3, capture.out);
+    atomic_fetch_add(&capture.n_written, 1);
+
+    pthread_mutex_lock(&capture.mut);
+    capture.head = (capture.head + 1) % CAPTURE_QUEUE;
+    capture.n--;
+    pthread_cond_broadcast(&capture.cond);
+    pthread_mutex_unlock(&capture.mut);
+  }
+  return NULL;
+}
+
+// "|command" pipes the stream into a process, anything else is a file
+bool capture_start(const char *target) {
+  capture.is_pipe = target[0] == '|';
+  capture.out = capture.is_pipe ? popen(target + 1, "w") : fopen(target, "wb");
+  if (capture.out == NULL) {
+    perror(target);
+    return false;
+  }
+  fprintf(capture.out, "YUV4MPEG2 W%d H%d F60:1 Ip A1:1 C444\n", world.width, world.height);
+
+  for (int i = 0; i < CAPTURE_QUEUE; i++)
+    capture.frames[i] = world_alloc((size_t)world.width * world.height * sizeof(uint16_t));
+  capture.yuv = world_alloc((size_t)world.width * world.height * 3);
+  pthread_create(&capture.thread, NULL, capture_thread, NULL);
+  return true;
+}
+
+// Leader only, between rounds
+void capture_frame(void) {
+  pthread_mutex_lock(&capture.mut);
+  if (capture.n == CAPTURE_QUEUE) {
+    if (!capture.lossless) {
+      atomic_fetch_add(&capture.n_dropped, 1);
+      pthread_mutex_unlock(&capture.mut);
+      return;
+    }
+    atomic_fetch_add(&capture.n_stalls, 1);
+    while (capture.n == CAPTURE_QUEUE)
+      pthread_cond_wait(&capture.cond, &capture.mut);
+  }
+  int slot = (capture.head + capture.n) % CAPTURE_QUEUE;
+  pthread_mutex_unlock(&capture.mut);
+
+  for (int y = 0; y < world.height; y++)
+    world_read_row(0, y, world.width, (union color_rgb565 *)capture.frames[slot] + (size_t)y * world.width);
+
+  pthread_mutex_lock(&capture.mut);
+  capture.n++;
+  pthread_cond_broadcast(&capture.cond);
+  pthread_mutex_unlock(&capture.mut);
+}
+
+// Drains the queue and closes the stream
+void capture_stop(void) {
+  if (capture.out == NULL) return;
+  pthread_mutex_lock(&capture.mut);
+  capture.stop = true;
+  pthread_cond_broadcast(&capture.cond);
+  pthread_mutex_unlock(&capture.mut);
+  pthread_join(capture.thread, NULL);
+  if (capture.is_pipe) pclose(capture.out); else fclose(capture.out);
+  capture.out = NULL;
+}
+
+// The only full scan, once the world is seeded or loaded: from then on the
+// stats follow the paint deltas. A strip counts its own rows
+void stats_scan(void) {
+  memset(&world.stats, 0, sizeof(world.stats));
+  for (int y = 0; y < world.height; y++)
+    for (int x = 0; x < world.width && strip_owns_row(y); x++)
+      stats_paint(&world.stats, (union color_rgb565){ 0 }, world.curr[cell_index(x, y)]);
+}
+
+// Leader only, after a round: adds up what the workers painted
+void stats_fold(void) {
+  for (int i = 0; i < world.engine.n_threads; i++) {
+    struct color_stats *s = &world.engine.workers[i].stats;
+    world.stats.occupied += s->occupied;
+    for (int v = 0; v < 32; v++) world.stats.r[v] += s->r[v];
+    for (int v = 0; v < 64; v++) world.stats.g[v] += s->g[v];
+    for (int v = 0; v < 32; v++) world.stats.b[v] += s->b[v];
+    memset(s, 0, sizeof(*s));
+  }
+}
+
+// Stats stream (--stats FILE): a CSV row every `every` rounds with the
+// live cell count, the growth per round since the last row and the three
+// channel histograms
+static struct stats_csv {
+  FILE *out;
+  uint64_t every, last_step;
+  int64_t last_occupied;
+  double start;
+} stats_csv = {
+  .every = 16,
+};
+
+// Leader only, or before the sim starts
+void stats_write(void) {
+  uint64_t steps = world.engine.step - stats_csv.last_step;
+  fprintf(stats_csv.out, "%lu,%.3f,%ld,%.1f", world.engine.step, time_now() - stats_csv.start, world.stats.occupied,
+      steps ? (double)(world.stats.occupied - stats_csv.last_occupied) / steps : 0.0);
+  for (int v = 0; v < 32; v++) fprintf(stats_csv.out, ",%ld", world.stats.r[v]);
+  for (int v = 0; v < 64; v++) fprintf(stats_csv.out, ",%ld", world.stats.g[v]);
+  for (int v = 0; v < 32; v++) fprintf(stats_csv.out, ",%ld", world.stats.b[v]);
+  fputc('\n', stats_csv.out);
+  stats_csv.last_step = world.engine.step;
+  stats_csv.last_occupied = world.stats.occupied;
+}
+
+bool stats_start(const char *path) {
+  stats_csv.out = fopen(path, "w");
+  if (stats_csv.out == NULL) {
+    perror(path);
+    return false;
+  }
+  fputs("step,seconds,occupied,growth_per_step", stats_csv.out);
+  for (int v = 0; v < 32; v++) fprintf(stats_csv.out, ",r%d", v);
+  for (int v = 0; v < 64; v++) fprintf(stats_csv.out, ",g%d", v);
+  for (int v = 0; v < 32; v++) fprintf(stats_csv.out, ",b%d", v);
+  fputc('\n', stats_csv.out);
+  stats_csv.start = time_now();
+  stats_csv.last_step = world.engine.step;
+  stats_csv.last_occupied = world.stats.occupied;
+  stats_write();
+  return true;
+}
+
+void stats_stop(void) {
+  if (stats_csv.out == NULL) return;
+  if (world.engine.step != stats_csv.last_step)
+    stats_write();
+  fclose(stats_csv.out);
+  stats_csv.out = NULL;
+}
+
+// Timeline (--timeline FILE): every cell painted, so a run can be scrubbed
+// afterwards. The file is a timeline_header, then blocks: a timeline_block
+// and `size` bytes of zlib data inflating to `raw_size`. A keyframe is the
+// row-major grid at `step`. A delta block holds n_steps records, record k
+// being the cells that changed in the round from step + k to step + k + 1:
+// a varint run count, then per run the varint gap from the end of the last
+// run, the varint length and that many little endian colours. Workers log
+// their writes into the round's queue slot and a writer thread replays them
+// onto a shadow grid, which the keyframes are taken from. Rounds can't be
+// dropped like capture frames, so a full queue stalls the sim
+struct timeline_header {
+  char magic[8];
+  uint32_t version, keyframe_every;
+  int32_t width, height;
+  uint64_t seed, start_step;
+};
+
+enum timeline_block_type {
+  TIMELINE_KEYFRAME = 1,
+  TIMELINE_DELTAS = 2,
+};
+
+struct timeline_block {
+  uint32_t type, n_steps;
+  uint64_t step;
+  uint32_t raw_size, size;
+};
+
+static struct timeline {
+  FILE *out;
+  bool stop;
+  uint64_t keyframe_every;
+  pthread_t thread;
+  pthread_mutex_t mut;
+  pthread_cond_t cond;
+  struct timeline_round {
+    uint64_t step; // after the round
+    int n_threads, n_phases;
+    struct delta_log logs[MAX_THREADS];
+  } rounds[TIMELINE_QUEUE];
+  int head, n, fill;
+  // Writer side: the grid as of the last round taken, cells touched by the
+  // round being encoded (bits and list), the delta block being built
+  uint16_t *shadow;
+  uint64_t *marks;
+  uint32_t *touched;
+  size_t cap_touched;
+  uint8_t *raw, *packed;
+  size_t raw_size, raw_cap, packed_cap;
+  uint64_t block_step;
+  int block_steps;
+  bool changed; // since the last keyframe
+  atomic_uint_fast64_t n_rounds, n_stalls, n_bytes;
+} timeline = {
+  .mut = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+  .keyframe_every = TIMELINE_KEYFRAME_EVERY,
+};
+
+static inline uint8_t *varint_put(uint8_t *p, uint64_t v) {
+  for (; v >= 0x80; v >>= 7)
+    *p++ = v | 0x80;
+  *p++ = v;
+  return p;
+}
+
+// NULL when the varint runs past `end`
+static inline const uint8_t *varint_get(const uint8_t *p, const uint8_t *end, uint64_t *v) {
+  *v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    *v |= (uint64_t)(*p & 0x7F) << shift;
+    if (!(*p++ & 0x80)) return p;
+  }
+  return NULL;
+}
+
+int cmp_u32(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+void timeline_write(uint32_t type, uint32_t n_steps, uint64_t step, const void *raw, size_t raw_size) {
+  uLongf size = compressBound(raw_size);
+  if (size > timeline.packed_cap) {
+    timeline.packed_cap = size;
+    timeline.packed = realloc(timeline.packed, size);
+  }
+  compress2(timeline.packed, &size, raw, raw_size, Z_BEST_SPEED);
+  struct timeline_block block = { .type = type, .n_steps = n_steps, .step = step, .raw_size = raw_size, .size = size };
+  fwrite(&block, sizeof(block), 1, timeline.out);
+  fwrite(timeline.packed, 1, size, timeline.out);
+  fflush(timeline.out);
+  atomic_fetch_add(&timeline.n_bytes, sizeof(block) + size);
+}
+
+void timeline_flush(void) {
+  if (timeline.block_steps == 0) return;
+  timeline_write(TIMELINE_DELTAS, timeline.block_steps, timeline.block_step, timeline.raw, timeline.raw_size);
+  timeline.block_step += timeline.block_steps;
+  timeline.block_steps = 0;
+  timeline.raw_size = 0;
+}
+
+// Replays a round onto the shadow grid in paint order and appends the final
+// colour of every cell it touched as a record
+void timeline_encode(struct timeline_round *r) {
+  size_t n = 0;
+  for (int p = 0; p < r->n_phases; p++) {
+    for (int w = 0; w < r->n_threads; w++) {
+      struct delta_log *l = &r->logs[w];
+      for (int k = p > 0 ? l->phase_end[p - 1] : 0; k < l->phase_end[p]; k++) {
+        uint32_t i = l->cells[k] >> 16;
+        timeline.shadow[i] = l->cells[k];
+        if (timeline.marks[i / 64] >> (i % 64) & 1) continue;
+        timeline.marks[i / 64] |= 1ull << (i % 64);
+        if (n == timeline.cap_touched) {
+          timeline.cap_touched = timeline.cap_touched ? timeline.cap_touched * 2 : 4096;
+          timeline.touched = realloc(timeline.touched, timeline.cap_touched * sizeof(uint32_t));
+        }
+        timeline.touched[n++] = i;
+      }
+    }
+  }
+  if (n) qsort(timeline.touched, n, sizeof(uint32_t), cmp_u32);
+
+  size_t n_runs = 0;
+  for (size_t k = 0; k < n; k++)
+    n_runs += k == 0 || timeline.touched[k] != timeline.touched[k - 1] + 1;
+  if (timeline.raw_size + 10 + n_runs * 20 + n * 2 > timeline.raw_cap) {
+    timeline.raw_cap = (timeline.raw_size + 10 + n_runs * 20 + n * 2) * 2;
+    timeline.raw = realloc(timeline.raw, timeline.raw_cap);
+  }
+  uint8_t *p = varint_put(timeline.raw + timeline.raw_size, n_runs);
+  uint32_t end = 0;
+  for (size_t k = 0; k < n;) {
+    uint32_t first = timeline.touched[k], run = 1;
+    while (k + run < n && timeline.touched[k + run] == first + run) run++;
+    p = varint_put(p, first - end);
+    p = varint_put(p, run);
+    for (uint32_t i = first; i < first + run; i++) {
+      *p++ = timeline.shadow[i];
+      *p++ = timeline.shadow[i] >> 8;
+      timeline.marks[i / 64] = 0;
+    }
+    end = first + run;
+    k += run;
+  }
+  timeline.raw_size = p - timeline.raw;
+  timeline.block_steps++;
+  timeline.changed |= n > 0;
+}
+
+void *timeline_thread(void *_) {
+  size_t grid_size = (size_t)world.width * world.height * sizeof(uint16_t);
+
+  while (true) {
+    pthread_mutex_lock(&timeline.mut);
+    // A sim that parks mid-block still gets its last rounds on disk
+    while (timeline.n == 0 && !timeline.stop) {
+      if (timeline.block_steps == 0) {
+        pthread_cond_wait(&timeline.cond, &timeline.mut);
+        continue;
+      }
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      ts.tv_sec += 1;
+      pthread_cond_timedwait(&timeline.cond, &timeline.mut, &ts);
+      if (timeline.n == 0) {
+        pthread_mutex_unlock(&timeline.mut);
+        timeline_flush();
+        pthread_mutex_lock(&timeline.mut);
+      }
+    }
+    if (timeline.n == 0) {
+      pthread_mutex_unlock(&timeline.mut);
+      break;
+    }
+    struct timeline_round *r = &timeline.rounds[timeline.head];
+    pthread_mutex_unlock(&timeline.mut);
+
+    timeline_encode(r);
+    bool keyframe = r->step % timeline.keyframe_every == 0;
+    if (keyframe || timeline.block_steps == TIMELINE_BLOCK)
+      timeline_flush();
+    if (keyframe && timeline.changed) {
+      timeline_write(TIMELINE_KEYFRAME, 0, r->step, timeline.shadow, grid_size);
+      timeline.changed = false;
+    }
+    atomic_fetch_add(&timeline.n_rounds, 1);
+
+    pthread_mutex_lock(&timeline.mut);
+    timeline.head = (timeline.head + 1) % TIMELINE_QUEUE;
+    timeline.n--;
+    pthread_cond_broadcast(&timeline.cond);
+    pthread_mutex_unlock(&timeline.mut);
+  }
+  timeline_flush();
+  return NULL;
+}
+
+// Writes the header and a first keyframe of the grid as it is now
+bool timeline_start(const char *path) {
+  timeline.out = fopen(path, "wb");
+  if (timeline.out == NULL) {
+    perror(path);
+    return false;
+  }
+  struct timeline_header hdr = {
+    .magic = TIMELINE_MAGIC,
+    .version = TIMELINE_VERSION,
+    .keyframe_every = timeline.keyframe_every,
+    .width = world.width,
+    .height = world.height,
+    .seed = world.engine.seed,
+    .start_step = world.engine.step,
+  };
+  fwrite(&hdr, sizeof(hdr), 1, timeline.out);
+
+  size_t cells = (size_t)world.width * world.height;
+  timeline.shadow = world_alloc(cells * sizeof(uint16_t));
+  timeline.marks = calloc((cells + 63) / 64, sizeof(uint64_t));
+  for (int y = 0; y < world.height; y++)
+    world_read_row(0, y, world.width, (union color_rgb565 *)timeline.shadow + (size_t)y * world.width);
+  timeline.block_step = world.engine.step;
+  timeline_write(TIMELINE_KEYFRAME, 0, world.engine.step, timeline.shadow, cells * sizeof(uint16_t));
+  pthread_create(&timeline.thread, NULL, timeline_thread, NULL);
+  return true;
+}
+
+// Leader only, before a round: points every worker at a free queue slot
+void timeline_round_begin(void) {
+  pthread_mutex_lock(&timeline.mut);
+  if (timeline.n == TIMELINE_QUEUE) {
+    atomic_fetch_add(&timeline.n_stalls, 1);
+    while (timeline.n == TIMELINE_QUEUE)
+      pthread_cond_wait(&timeline.cond, &timeline.mut);
+  }
+  timeline.fill = (timeline.head + timeline.n) % TIMELINE_QUEUE;
+  pthread_mutex_unlock(&timeline.mut);
+
+  struct timeline_round *r = &timeline.rounds[timeline.fill];
+  r->n_threads = world.engine.n_threads;
+  r->n_phases = world.engine.n_phases;
+  for (int i = 0; i < world.engine.n_threads; i++) {
+    r->logs[i].n = 0;
+    world.engine.workers[i].log = &r->logs[i];
+  }
+}
+
+// Leader only, after a round
+void timeline_round_end(void) {
+  timeline.rounds[timeline.fill].step = world.engine.step;
+  pthread_mutex_lock(&timeline.mut);
+  timeline.n++;
+  pthread_cond_broadcast(&timeline.cond);
+  pthread_mutex_unlock(&timeline.mut);
+}
+
+// Drains the queue and closes the file
+void timeline_stop(void) {
+  if (timeline.out == NULL) return;
+  pthread_mutex_lock(&timeline.mut);
+  timeline.stop = true;
+  pthread_cond_broadcast(&timeline.cond);
+  pthread_mutex_unlock(&timeline.mut);
+  pthread_join(timeline.thread, NULL);
+  fclose(timeline.out);
+  timeline.out = NULL;
+}
+
+// Multi-process strips (--procs N): the world is cut into N bands of whole
+// tile rows, each run by a forked process with its own grid and bit planes.
+// Only a band and the rows around it are ever touched, so that's all the
+// memory a strip uses. Tiles still go in the global phase order, and after
+// every phase each strip posts two things to its mailbox: the cells it
+// painted next to a boundary, and the cells it claimed in a neighbour's
+// tiles for that neighbour's frontier. Then all strips meet at a
+// process-shared barrier. A phase never has tiles active on both sides of a
+// boundary, so replaying the neighbours' records gives every strip the halo
+// a single process would have, and the run hashes the same. The parent only
+// stitches: strips copy their changed tiles into a shared frame that is the
+// parent's grid, and flag them in a shared dirty bitmap
+struct strip_box {
+  int n_cells, n_born;
+  long n_occupied, n_frontier; // of the sender, after the phase
+};
+
+static struct strips {
+  int n, self, threads; // self is -1 in the parent
+  pid_t pids[MAX_PROCS];
+  struct strip_shared {
+    pthread_barrier_t barrier;
+    bool live; // the parent is showing the world, publish as we go
+    atomic_uint_fast64_t n_steps[MAX_PROCS], n_grown[MAX_PROCS], step[MAX_PROCS];
+    struct color_stats stats[MAX_PROCS]; // may be torn while a strip runs
+    struct strip_box boxes[MAX_PROCS][2]; // by exchange parity
+  } *shared;
+  // Mailbox records, box_cap painted cells (index << 16 | color) then
+  // box_cap claims (source tile << 32 | index) per strip and parity
+  uint64_t *mail;
+  size_t box_cap, mail_size;
+  union color_rgb565 *frame;
+  atomic_uint_fast64_t *dirty;
+  int neighbours[2], n_neighbours;
+  uint64_t epoch;
+  long n_occupied, n_frontier; // over all strips, as of the last exchange
+  double last_publish;
+  bool failed;
+  pthread_t monitor;
+} strips = { .self = -1 };
+
+void strip_rows(int i, int *y0, int *y1) {
+  int tiles_y = (world.height + TILE_SIZE - 1) / TILE_SIZE;
+  *y0 = tiles_y * i / strips.n * TILE_SIZE;
+  *y1 = tiles_y * (i + 1) / strips.n * TILE_SIZE;
+  if (*y1 > world.height) *y1 = world.height;
+}
+
+static inline uint64_t *strip_mail(int i, int parity) {
+  return strips.mail + ((size_t)i * 2 + parity) * 2 * strips.box_cap;
+}
+
+// Leader only, after every phase (and once before the first round)
+void strip_exchange(void) {
+  int parity = strips.epoch++ & 1;
+  struct strip_box *box = &strips.shared->boxes[strips.self][parity];
+  uint64_t *cells = strip_mail(strips.self, parity), *born = cells + strips.box_cap;
+
+  box->n_cells = box->n_born = 0;
+  for (int w = 0; w < world.engine.n_threads; w++) {
+    struct strip_log *l = world.engine.workers[w].halo;
+    if (box->n_cells + l->cells.n > strips.box_cap || box->n_born + l->born.n / 2 > strips.box_cap) {
+      fprintf(stderr, "strip %d: halo mailbox overflow\n", strips.self);
+      _exit(1);
+    }
+    for (int k = 0; k < l->cells.n; k++)
+      cells[box->n_cells++] = l->cells.cells[k];
+    for (int k = 0; k < l->born.n; k += 2)
+      born[box->n_born++] = (uint64_t)l->born.cells[k] << 32 | l->born.cells[k + 1];
+    l->cells.n = l->born.n = 0;
+  }
+  box->n_occupied = world.stats.occupied;
+  for (int w = 0; w < world.engine.n_threads; w++)
+    box->n_occupied += world.engine.workers[w].stats.occupied;
+  box->n_frontier = atomic_load(&world.engine.n_frontier);
+  pthread_barrier_wait(&strips.shared->barrier);
+
+  int up = world.strip.y0 - 1, down = world.strip.y1;
+  if (world.engine.wrap) {
+    up = wrap_coord(up, world.height);
+    down = wrap_coord(down, world.height);
+  }
+  for (int q = 0; q < strips.n_neighbours; q++) {
+    struct strip_box *in = &strips.shared->boxes[strips.neighbours[q]][parity];
+    uint64_t *in_cells = strip_mail(strips.neighbours[q], parity), *in_born = in_cells + strips.box_cap;
+    for (int k = 0; k < in->n_cells; k++) {
+      int i = in_cells[k] >> 16, x = i % world.width, y = i / world.width;
+      union color_rgb565 c = { .color = in_cells[k] & 0xFFFF };
+      if (!strip_owns_row(y) && y != up && y != down) continue;
+      W_SET(world.curr, x, y, c);
+      if (c.color) occ_set(world.occ, x, y); else occ_clear(world.occ, x, y);
+    }
+    for (int k = 0; k < in->n_born; k++) {
+      int tile = in_born[k] >> 32, i = in_born[k] & 0xFFFFFFFF;
+      if (strip_owns_row(i / world.width)) frontier_add(tile, i % world.width, i / world.width);
+    }
+  }
+
+  strips.n_occupied = strips.n_frontier = 0;
+  for (int i = 0; i < strips.n; i++) {
+    strips.n_occupied += strips.shared->boxes[i][parity].n_occupied;
+    strips.n_frontier += strips.shared->boxes[i][parity].n_frontier;
+  }
+}
+
+// Leader only, after a round: counters for the parent, and the changed
+// tiles of the band when it is showing them (or `force`)
+void strip_publish(bool force) {
+  struct strip_shared *sh = strips.shared;
+  uint64_t steps = 0, grown = 0;
+  for (int i = 0; i < world.engine.n_threads; i++) {
+    steps += atomic_load_explicit(&world.engine.workers[i].n_steps, memory_order_relaxed);
+    grown += atomic_load_explicit(&world.engine.workers[i].n_grown, memory_order_relaxed);
+  }
+  atomic_store(&sh->n_steps[strips.self], steps);
+  atomic_store(&sh->n_grown[strips.self], grown);
+  atomic_store(&sh->step[strips.self], world.engine.step);
+  sh->stats[strips.self] = world.stats;
+
+  double now = time_now();
+  if (!force && (!sh->live || now - strips.last_publish < PUBLISH_INTERVAL)) return;
+  strips.last_publish = now;
+  for (int w = 0; w < world.n_dirty_words; w++) {
+    uint64_t bits = atomic_exchange_explicit(&world.dirty[w], 0, memory_order_relaxed), copied = 0;
+    for (; bits; bits &= bits - 1) {
+      int tile = w * 64 + __builtin_ctzll(bits), x0, y0, tw, th;
+      tile_bounds(tile, &x0, &y0, &tw, &th);
+      if (!strip_owns_row(y0)) continue;
+      for (int y = y0; y < y0 + th; y++)
+        for (int x = x0; x < x0 + tw; x++)
+          strips.frame[cell_index(x, y)] = world.curr[cell_index(x, y)];
+      copied |= 1ull << (tile % 64);
+    }
+    if (copied) atomic_fetch_or_explicit(&strips.dirty[w], copied, memory_order_release);
+  }
+}
+
+// Nothing left to grow: the frontier is empty, or in random mode every cell
+// is taken (painted a colour, black stays empty). Strips go by the totals of
+// the last exchange, which they all agree on
+bool world_saturated(void) {
+  if (world.engine.mode == ENGINE_FRONTIER)
+    return (world.strip.split ? strips.n_frontier : atomic_load(&world.engine.n_frontier)) == 0;
+  return (world.strip.split ? strips.n_occupied : world.stats.occupied) >= (long)world.width * world.height;
+}
+
+// Wakes a parked or pacing leader after the pacing settings changed
+void world_wake(void) {
+  pthread_mutex_lock(&world.engine.mut_pace);
+  world.engine.generation++;
+  pthread_cond_signal(&world.engine.wake);
+  pthread_mutex_unlock(&world.engine.mut_pace);
+}
+
+bool world_paused(void) {
+  pthread_mutex_lock(&world.engine.mut_pace);
+  bool paused = world.engine.paused;
+  pthread_mutex_unlock(&world.engine.mut_pace);
+  return paused;
+}
+
+// Pause is rechecked under the lock, so an unpause that came in since the
+// leader decided to park doesn't get lost
+void world_park(bool idle) {
+  pthread_mutex_lock(&world.engine.mut_pace);
+  uint64_t generation = world.engine.generation;
+  world.engine.parked = idle || world.engine.paused;
+  while (world.engine.parked && generation == world.engine.generation)
+    pthread_cond_wait(&world.engine.wake, &world.engine.mut_pace);
+  world.engine.parked = false;
+  pthread_mutex_unlock(&world.engine.mut_pace);
+}
+
+// Sleeps until the next round is due. Rounds are scheduled from the start of
+// the pacing window rather than from the last one so the rate doesn't drift,
+// and a leader that falls too far behind restarts the window instead of bursting.
+// So does a change of settings (a new generation)
+void world_pace(void) {
+  pthread_mutex_lock(&world.engine.mut_pace);
+  while (world.engine.rate > 0 && !world.engine.fast_forward) {
+    double now = time_now();
+    if (world.engine.pace_generation != world.engine.generation) {
+      world.engine.pace_generation = world.engine.generation;
+      world.engine.pace_time = now;
+      world.engine.pace_step = world.engine.step;
+    }
+    double due = world.engine.pace_time + (world.engine.step - world.engine.pace_step) / world.engine.rate;
+    if (now >= due) {
+      if (now - due > PACE_SLACK) {
+        world.engine.pace_time = now;
+        world.engine.pace_step = world.engine.step;
+      }
+      break;
+    }
+    struct timespec ts = { .tv_sec = due, .tv_nsec = (due - (time_t)due) * 1e9 };
+    pthread_cond_timedwait(&world.engine.wake, &world.engine.mut_pace, &ts);
+  }
+  pthread_mutex_unlock(&world.engine.mut_pace);
+}
+
+// Every worker runs the same loop; worker 0 is the leader which takes the
+// world lock for a whole round (all phases) and resets the tile counters
+void *world_update(void *arg) {
+  struct worker *self = arg;
+  bool leader = self == &world.engine.workers[0];
+
+  if (leader && world.strip.split)
+    strip_exchange();
+  while (true) {
+    if (leader) {
+      bool idle = world_saturated();
+      if (world.engine.max_steps != 0 && (idle || world.engine.step >= world.engine.max_steps)) {
+        world.engine.done = true;
+      } else if (idle || world_paused()) {
+        // Under the lock: main tears down shm with it held on the way out
+        world_lock();
+        world_publish(true);
+        world_unlock();
+        world_park(idle);
+        continue;
+      } else {
+        world_pace();
+      }
+      world_lock();
+      if (world.checkpoint && world.checkpoint->clean)
+        world.checkpoint->clean = 0;
+      if (timeline.out)
+        timeline_round_begin();
+      for (int p = 0; p < world.engine.n_phases; p++)
+        atomic_store_explicit(&world.engine.next_tile[p], 0, memory_order_relaxed);
+    }
+    pthread_barrier_wait(&world.engine.barrier);
+    if (world.engine.done) break;
+
+    for (int p = 0; p < world.engine.n_phases; p++) {
+      int n;
+      while ((n = atomic_fetch_add(&world.engine.next_tile[p], 1)) < world.engine.n_phase_tiles[p]) {
+        if (world.engine.mode == ENGINE_FRONTIER)
+          world_update_tile_frontier(self, world.engine.phase_tiles[p][n]);
+        else if (world.engine.mode == ENGINE_SWEEP)
+          world_update_tile_sweep(self, world.engine.phase_tiles[p][n]);
+        else
+          world_update_tile(self, world.engine.phase_tiles[p][n]);
+      }
+      if (self->log)
+        self->log->phase_end[p] = self->log->n;
+      pthread_barrier_wait(&world.engine.barrier);
+      if (world.strip.split) {
+        if (leader) strip_exchange();
+        pthread_barrier_wait(&world.engine.barrier);
+      }
+    }
+
+    if (leader) {
+      world.engine.step++;
+      stats_fold();
+      if (stats_csv.out && world.engine.step % stats_csv.every == 0)
+        stats_write();
+      if (capture.out && world.engine.step % capture.every == 0)
+        capture_frame();
+      if (timeline.out)
+        timeline_round_end();
+      if (world.strip.split)
+        strip_publish(false);
+      else
+        world_publish(false);
+      world_unlock();
+    }
+  }
+  if (leader) world_unlock();
+  return NULL;
+}
+
+void world_seed(void) {
+  for (int i = 0; i < 16; i++) {
+    uint64_t r = rng_at(world.engine.seed, 0, rng_key(i, RNG_SEED));
+    int j = (r >> 16) % (world.width * world.height), x = j % world.width, y = j / world.width;
+    if (world.curr[cell_index(x, y)].color == 0 && (r & 0xFFFF) != 0) {
+      frontier_add(x / TILE_SIZE + (y / TILE_SIZE) * world.tiles_x, x, y);
+      world.engine.n_frontier++;
+    }
+    world.curr[cell_index(x, y)].color = r & 0xFFFF;
+    if (r & 0xFFFF) occ_set(world.occ, x, y);
+    tile_mark_dirty(x / TILE_SIZE + (y / TILE_SIZE) * world.tiles_x);
+  }
+}
+
+// Rebuilds what isn't stored in a checkpoint: every tile needs uploading and
+// the frontier is every live cell with an empty neighbour
+void world_resume(void) {
+  for (int y = 0; y < world.height; y++)
+    for (int x = 0; x < world.width; x++)
+      if (world.curr[cell_index(x, y)].color) occ_set(world.occ, x, y);
+
+  for (int tile = 0; tile < world.n_tiles; tile++) {
+    tile_mark_dirty(tile);
+    if (world.engine.mode != ENGINE_FRONTIER) continue;
+
+    int x0, y0, tw, th;
+    tile_bounds(tile, &x0, &y0, &tw, &th);
+    for (int y = y0; y < y0 + th; y++) {
+      for (int x = x0; x < x0 + tw; x++) {
+        if (world.curr[cell_index(x, y)].color == 0) continue;
+        bool room = false;
+        for (int oy = -1; oy <= 1 && !room; oy++) {
+          for (int ox = -1; ox <= 1 && !room; ox++) {
+            int nx = x + ox, ny = y + oy;
+            if (world.engine.wrap) {
+              nx = wrap_coord(nx, world.width);
+              ny = wrap_coord(ny, world.height);
+            }
+            room = nx >= 0 && ny >= 0 && nx < world.width && ny < world.height && world.curr[cell_index(nx, ny)].color == 0;
+          }
+        }
+        if (!room) continue;
+        frontier_add(tile, x, y);
+        world.engine.n_frontier++;
+      }
+    }
+  }
+}
+
+void world_start(int n_threads) {
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  pthread_cond_init(&world.engine.wake, &attr);
+  pthread_condattr_destroy(&attr);
+  world.engine.pace_time = time_now();
+  world.engine.pace_step = world.engine.step;
+
+  // With wrap, the first and last tile of an odd row or column touch and
+  // would share a colour, so the last one gets a third
+  int cx = world.engine.wrap && world.tiles_x > 1 && world.tiles_x % 2 ? 3 : 2;
+  int cy = world.engine.wrap && world.tiles_y > 1 && world.tiles_y % 2 ? 3 : 2;
+  world.engine.n_phases = cx * cy;
+  for (int ty = 0; ty < world.tiles_y; ty++) {
+    for (int tx = 0; tx < world.tiles_x && strip_owns_row(ty * TILE_SIZE); tx++) {
+      int px = cx == 3 && tx == world.tiles_x - 1 ? 2 : tx & 1;
+      int py = cy == 3 && ty == world.tiles_y - 1 ? 2 : ty & 1;
+      int p = px + py * cx;
+      world.engine.phase_tiles[p][world.engine.n_phase_tiles[p]++] = tx + ty * world.tiles_x;
+    }
+  }
+
+  world.engine.n_threads = n_threads;
+  pthread_barrier_init(&world.engine.barrier, NULL, n_threads);
+  for (int i = 0; i < n_threads; i++) {
+    pthread_create(&world.engine.threads[i], NULL, world_update, &world.engine.workers[i]);
+  }
+}
+
+// Small FIFO job pool for background work that must stay off the render loop
+static struct pool {
+  int n_threads;
+  pthread_t threads[MAX_THREADS];
+  pthread_mutex_t mut;
+  pthread_cond_t cond;
+  struct pool_job {
+    void (*fn)(void *);
+    void *arg;
+  } *jobs;
+  int head, n_jobs, cap_jobs;
+} pool = {
+  .mut = PTHREAD_MUTEX_INITIALIZER,
+  .cond = PTHREAD_COND_INITIALIZER,
+};
+
+void *pool_thread(void *_) {
+  while (true) {
+    pthread_mutex_lock(&pool.mut);
+    while (pool.head == pool.n_jobs)
+      pthread_cond_wait(&pool.cond, &pool.mut);
+    struct pool_job job = pool.jobs[pool.head++];
+    if (pool.head == pool.n_jobs) pool.head = pool.n_jobs = 0;
+    pthread_mutex_unlock(&pool.mut);
+    job.fn(job.arg);
+  }
+  return NULL;
+}
+
+void pool_start(int n_threads) {
+  pool.n_threads = n_threads;
+  for (int i = 0; i < n_threads; i++)
+    pthread_create(&pool.threads[i], NULL, pool_thread, NULL);
+}
+
+void pool_submit(void (*fn)(void *), void *arg) {
+  pthread_mutex_lock(&pool.mut);
+  if (pool.n_jobs == pool.cap_jobs) {
+    pool.cap_jobs = pool.cap_jobs ? pool.cap_jobs * 2 : 64;
+    pool.jobs = realloc(pool.jobs, pool.cap_jobs * sizeof(struct pool_job));
+  }
+  pool.jobs[pool.n_jobs++] = (struct pool_job) { fn, arg };
+  pthread_cond_signal(&pool.cond);
+  pthread_mutex_unlock(&pool.mut);
+}
+
+// PNG export: the grid is copied out under the world lock, then every strip
+// of rows is filtered and deflated on the pool as an independent raw deflate
+// stream ending on a byte boundary (Z_SYNC_FLUSH), so the strips concatenate
+// into one zlib stream, the same trick pigz uses
+struct png_export {
+  char path[256];
+  int width, height, n_strips;
+  uint16_t *pixels;
+  size_t pixels_size; // as mapped
+  struct png_strip {
+    struct png_export *png;
+    int y0, y1;
+    uint8_t *out;
+    size_t size;
+    uLong adler;
+  } *strips;
+  int n_left;
+  pthread_mutex_t mut;
+  pthread_cond_t done;
+};
+
+static atomic_bool export_busy;
+
+void png_strip_encode(void *arg) {
+  struct png_strip *strip = arg;
+  struct png_export *png = strip->png;
+  size_t stride = 1 + (size_t)png->width * 3, raw_size = stride * (strip->y1 - strip->y0);
+  uint8_t *raw = malloc(raw_size);
+
+  for (int y = strip->y0; y < strip->y1; y++) {
+    uint8_t *row = raw + (y - strip->y0) * stride;
+    row[0] = 1; // Sub filter
+    for (int x = 0; x < png->width; x++) {
+      Color c = color_565rgb((union color_rgb565){ .color = png->pixels[x + (size_t)y * png->width] });
+      row[1 + x * 3 + 0] = c.r;
+      row[1 + x * 3 + 1] = c.g;
+      row[1 + x * 3 + 2] = c.b;
+    }
+    for (int x = png->width * 3 - 1; x >= 3; x--)
+      row[1 + x] -= row[1 + x - 3];
+  }
+
+  z_stream zs = { 0 };
+  deflateInit2(&zs, 6, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+  strip->out = malloc(deflateBound(&zs, raw_size) + 16);
+  zs.next_in = raw;
+  zs.avail_in = raw_size;
+  zs.next_out = strip->out;
+  zs.avail_out = deflateBound(&zs, raw_size) + 16;
+  deflate(&zs, strip->y1 == png->height ? Z_FINISH : Z_SYNC_FLUSH);
+  strip->size = zs.total_out;
+  deflateEnd(&zs);
+  strip->adler = adler32(adler32(0, NULL, 0), raw, raw_size);
+  free(raw);
+
+  pthread_mutex_lock(&png->mut);
+  if (--png->n_left == 0) pthread_cond_signal(&png->done);
+  pthread_mutex_unlock(&png->mut);
+}
+
+void png_chunk(FILE *f, const char *type, const uint8_t *data, uint32_t size) {
+  uint8_t be[4] = { size >> 24, size >> 16, size >> 8, size };
+  uLong crc = crc32(crc32(0, NULL, 0), (const Bytef *)type, 4);
+  if (size) crc = crc32(crc, data, size);
+  fwrite(be, 1, 4, f);
+  fwrite(type, 1, 4, f);
+  fwrite(data, 1, size, f);
+  uint8_t crc_be[4] = { crc >> 24, crc >> 16, crc >> 8, crc };
+  fwrite(crc_be, 1, 4, f);
+}
+
+struct png_export *png_new(const char *path, int width, int height) {
+  struct png_export *png = calloc(1, sizeof(struct png_export));
+  snprintf(png->path, sizeof(png->path), "%s", path);
+  png->width = width;
+  png->height = height;
+  png->pixels_size = (size_t)png->width * png->height * sizeof(uint16_t);
+  png->pixels = world_map(&png->pixels_size);
+  png->n_strips = (png->height + EXPORT_STRIP_ROWS - 1) / EXPORT_STRIP_ROWS;
+  png->strips = calloc(png->n_strips, sizeof(struct png_strip));
+  png->n_left = png->n_strips;
+  pthread_mutex_init(&png->mut, NULL);
+  pthread_cond_init(&png->done, NULL);
+  for (int i = 0; i < png->n_strips; i++) {
+    png->strips[i].png = png;
+    png->strips[i].y0 = i * EXPORT_STRIP_ROWS;
+    png->strips[i].y1 = (i + 1) * EXPORT_STRIP_ROWS < png->height ? (i + 1) * EXPORT_STRIP_ROWS : png->height;
+  }
+  return png;
+}
+
+void png_free(struct png_export *png) {
+  for (int i = 0; i < png->n_strips; i++)
+    free(png->strips[i].out);
+  free(png->strips);
+  world_free(png->pixels, png->pixels_size);
+  free(png);
+}
+
+// Encodes png->pixels, on the pool if there is one, and writes the file
+bool png_write(struct png_export *png) {
+  for (int i = 0; i < png->n_strips; i++) {
+    if (pool.n_threads > 0)
+      pool_submit(png_strip_encode, &png->strips[i]);
+    else
+      png_strip_encode(&png->strips[i]);
+  }
+  pthread_mutex_lock(&png->mut);
+  while (png->n_left > 0)
+    pthread_cond_wait(&png->done, &png->mut);
+  pthread_mutex_unlock(&png->mut);
+
+  FILE *f = fopen(png->path, "wb");
+  if (f == NULL) {
+    perror(png->path);
+    return false;
+  }
+  {
+    uint8_t ihdr[13] = {
+      png->width >> 24, png->width >> 16, png->width >> 8, png->width,
+      png->height >> 24, png->height >> 16, png->height >> 8, png->height,
+      8, 2, 0, 0, 0 // 8-bit RGB
+    };
+    uint8_t zhdr[2] = { 0x78, 0x9C };
+    uLong adler = adler32(0, NULL, 0);
+    fwrite("\x89PNG\r\n\x1a\n", 1, 8, f);
+    png_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+    png_chunk(f, "IDAT", zhdr, sizeof(zhdr));
+    for (int i = 0; i < png->n_strips; i++) {
+      struct png_strip *strip = &png->strips[i];
+      size_t raw_size = (1 + (size_t)png->width * 3) * (strip->y1 - strip->y0);
+      png_chunk(f, "IDAT", strip->out, strip->size);
+      adler = adler32_combine(adler, strip->adler, raw_size);
+    }
+    uint8_t adler_be[4] = { adler >> 24, adler >> 16, adler >> 8, adler };
+    png_chunk(f, "IDAT", adler_be, sizeof(adler_be));
+    png_chunk(f, "IEND", NULL, 0);
+    fclose(f);
+  }
+  return true;
+}
+
+void *png_export_thread(void *arg) {
+  struct png_export *png = arg;
+  double start = time_now();
+
+  world_lock();
+  for (int y = 0; y < png->height; y++)
+    world_read_row(0, y, png->width, (union color_rgb565 *)png->pixels + (size_t)y * png->width);
+  world_unlock();
+
+  if (png_write(png))
+    printf("export: %s written in %.3fs\n", png->path, time_now() - start);
+  png_free(png);
+  atomic_store(&export_busy, false);
+  return NULL;
+}
+
+// Returns immediately; false if an export is still running
+bool png_export_start(const char *path) {
+  if (atomic_exchange(&export_busy, true)) return false;
+
+  struct png_export *png = png_new(path, world.width, world.height);
+  pthread_t thrd;
+  pthread_create(&thrd, NULL, png_export_thread, png);
+  pthread_detach(thrd);
+  return true;
+}
+
+void world_join(void) {
+  for (int i = 0; i < world.engine.n_threads; i++)
+    pthread_join(world.engine.threads[i], NULL);
+}
+
+// Body of a strip process
+_Noreturn void strip_run(int self) {
+  strips.self = self;
+  world.strip.split = true;
+  strip_rows(self, &world.strip.y0, &world.strip.y1);
+  int up = self > 0 || world.engine.wrap ? (self + strips.n - 1) % strips.n : self;
+  int down = self < strips.n - 1 || world.engine.wrap ? (self + 1) % strips.n : self;
+  if (up != self) strips.neighbours[strips.n_neighbours++] = up;
+  if (down != self && down != up) strips.neighbours[strips.n_neighbours++] = down;
+
+  // Every strip seeds the whole world the same way, but only counts the
+  // frontier of its own tiles
+  world_init();
+  world_seed();
+  stats_scan();
+  world.engine.n_frontier = 0;
+  for (int tile = world.strip.y0 / TILE_SIZE * world.tiles_x; tile < world.n_tiles && strip_owns_row(tile / world.tiles_x * TILE_SIZE); tile++)
+    world.engine.n_frontier += world.engine.tiles[tile].frontier.n;
+  for (int i = 0; i < strips.threads; i++)
+    world.engine.workers[i].halo = calloc(1, sizeof(struct strip_log));
+  // Strips only stop by themselves, so without --steps they stop once saturated
+  if (world.engine.max_steps == 0)
+    world.engine.max_steps = UINT64_MAX;
+
+  world_start(strips.threads);
+  world_join();
+  strip_publish(true);
+  _exit(0);
+}
+
+// Forks the strips; the parent's grid becomes the shared frame
+bool strips_start(int n, int n_threads, bool live) {
+  int tiles_x = (world.width + TILE_SIZE - 1) / TILE_SIZE, tiles_y = (world.height + TILE_SIZE - 1) / TILE_SIZE;
+  if (n > MAX_PROCS || n > tiles_y) {
+    fprintf(stderr, "--procs: can't cut %d tile rows into %d strips (at most %d)\n", tiles_y, n, MAX_PROCS);
+    return false;
+  }
+  strips.n = n;
+  strips.threads = n_threads / n > 0 ? n_threads / n : 1;
+  // Only tiles along a boundary write mailbox records, at most 8 per pick
+  strips.box_cap = (size_t)2 * tiles_x * TILE_SIZE * TILE_SIZE * 8;
+  strips.mail_size = (size_t)n * 2 * 2 * strips.box_cap * sizeof(uint64_t);
+  size_t frame_size = world_cells() * sizeof(union color_rgb565);
+  size_t dirty_size = (size_t)(tiles_x * tiles_y + 63) / 64 * sizeof(uint64_t);
+  strips.shared = mmap(NULL, sizeof(struct strip_shared), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  strips.mail = mmap(NULL, strips.mail_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  strips.frame = mmap(NULL, frame_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  strips.dirty = mmap(NULL, dirty_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (strips.shared == MAP_FAILED || strips.mail == MAP_FAILED || strips.frame == MAP_FAILED || strips.dirty == MAP_FAILED) {
+    perror("mmap");
+    return false;
+  }
+
+  pthread_barrierattr_t attr;
+  pthread_barrierattr_init(&attr);
+  pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  pthread_barrier_init(&strips.shared->barrier, &attr, n);
+  pthread_barrierattr_destroy(&attr);
+  strips.shared->live = live;
+
+  fflush(stdout);
+  for (int i = 0; i < n; i++) {
+    strips.pids[i] = fork();
+    if (strips.pids[i] < 0) {
+      perror("fork");
+      for (int j = 0; j < i; j++)
+        kill(strips.pids[j], SIGKILL);
+      return false;
+    }
+    if (strips.pids[i] == 0)
+      strip_run(i);
+  }
+  world.curr = strips.frame;
+  return true;
+}
+
+// Totals of the strips as one engine with a worker per strip
+void strips_collect(void) {
+  uint64_t step = UINT64_MAX;
+  memset(&world.stats, 0, sizeof(world.stats));
+  for (int i = 0; i < strips.n; i++) {
+    struct color_stats *s = &strips.shared->stats[i];
+    world.stats.occupied += s->occupied;
+    for (int v = 0; v < 32; v++) world.stats.r[v] += s->r[v];
+    for (int v = 0; v < 64; v++) world.stats.g[v] += s->g[v];
+    for (int v = 0; v < 32; v++) world.stats.b[v] += s->b[v];
+    atomic_store_explicit(&world.engine.workers[i].n_steps, atomic_load(&strips.shared->n_steps[i]), memory_order_relaxed);
+    atomic_store_explicit(&world.engine.workers[i].n_grown, atomic_load(&strips.shared->n_grown[i]), memory_order_relaxed);
+    if (atomic_load(&strips.shared->step[i]) < step) step = atomic_load(&strips.shared->step[i]);
+  }
+  world.engine.step = step;
+}
+
+// Kills every strip left when one fails, since the others would wait for it
+// at the barrier forever
+void strips_reap(pid_t pid, int status) {
+  if ((WIFEXITED(status) && WEXITSTATUS(status) == 0) || strips.failed) return;
+  strips.failed = true;
+  fprintf(stderr, "strip process %d failed, stopping the others\n", pid);
+  for (int i = 0; i < strips.n; i++)
+    kill(strips.pids[i], SIGKILL);
+}
+
+// Parent in a window: publishes the stitched frame like the leader would
+void *strips_monitor(void *_) {
+  while (true) {
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+      strips_reap(pid, status);
+    world_lock();
+    strips_collect();
+    world_publish(false);
+    world_unlock();
+    usleep(PUBLISH_INTERVAL * 1e6);
+  }
+  return NULL;
+}
+
+// Parent, after world_init()
+void strips_attach(void) {
+  free(world.dirty);
+  world.dirty = strips.dirty;
+  world.engine.n_threads = strips.n;
+  if (strips.shared->live)
+    pthread_create(&strips.monitor, NULL, strips_monitor, NULL);
+}
+
+bool strips_join(void) {
+  for (int i = 0; i < strips.n; i++) {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid < 0) break;
+    strips_reap(pid, status);
+  }
+  strips_collect();
+  return !strips.failed;
+}
+
+void strips_stop(void) {
+  for (int i = 0; i < strips.n; i++)
+    kill(strips.pids[i], SIGTERM);
+  while (wait(NULL) > 0);
+}
+
+// FNV-1a over the RGB565 grid in row-major order, whatever the layout
+uint64_t world_hash(void) {
+  uint64_t h = 0xCBF29CE484222325ull;
+  for (int y = 0; y < world.height; y++) {
+    for (int x = 0; x < world.width; x++) {
+      uint16_t c = world.curr[cell_index(x, y)].color;
+      h = (h ^ (c & 0xFF)) * 0x100000001B3ull;
+      h = (h ^ (c >> 8)) * 0x100000001B3ull;
+    }
+  }
+  return h;
+}
+
+int run_headless(int n_threads) {
+  double start = time_now();
+  bool ok = true;
+  if (strips.n) {
+    ok = strips_join();
+  } else {
+    world_start(n_threads);
+    world_join();
+  }
+  double elapsed = time_now() - start;
+  if (world.checkpoint) checkpoint_save();
+  capture_stop();
+  timeline_stop();
+  stats_stop();
+  if (shm.hdr) world_publish(true);
+  shm_stop();
+
+  uint64_t steps = 0, grown = 0, occupied = world.stats.occupied;
+  for (int i = 0; i < world.engine.n_threads; i++) {
+    steps += world.engine.workers[i].n_steps;
+    grown += world.engine.workers[i].n_grown;
+  }
+
+  printf("seed:      %lu\n", world.engine.seed);
+  if (strips.n)
+    printf("procs:     %d, %d threads each\n", strips.n, strips.threads);
+  else
+    printf("threads:   %d\n", world.engine.n_threads);
+  printf("steps:     %lu\n", world.engine.step);
+  printf("wall time: %.3fs\n", elapsed);
+  printf("picks/s:   %.0f\n", steps / elapsed);
+  printf("grown/s:   %.0f\n", grown / elapsed);
+  printf("occupied:  %lu/%d (%.2f%%)\n", occupied, world.width * world.height, 100.0 * occupied / (world.width * world.height));
+  printf("hash:      %016lx\n", world_hash());
+  return ok ? 0 : 1;
+}
+
+// Box-filters the world down to a w x h thumbnail at out, stride in pixels
+void world_thumbnail(uint16_t *out, int w, int h, size_t stride) {
+  uint32_t *sum = calloc((size_t)w * 4, sizeof(uint32_t));
+  union color_rgb565 *row = malloc(world.width * sizeof(*row));
+  for (int ty = 0; ty < h; ty++) {
+    memset(sum, 0, (size_t)w * 4 * sizeof(uint32_t));
+    for (int y = ty * world.height / h; y < (ty + 1) * world.height / h; y++) {
+      world_read_row(0, y, world.width, row);
+      for (int x = 0; x < world.width; x++) {
+        uint32_t *s = &sum[(size_t)x * w / world.width * 4];
+        s[0] += row[x].rgb.r;
+        s[1] += row[x].rgb.g;
+        s[2] += row[x].rgb.b;
+        s[3]++;
+      }
+    }
+    for (int tx = 0; tx < w; tx++) {
+      uint32_t *s = &sum[tx * 4], n = s[3] ? s[3] : 1;
+      out[tx + ty * stride] = (s[0] + n / 2) / n << 11 | (s[1] + n / 2) / n << 5 | (s[2] + n / 2) / n;
+    }
+  }
+  free(row);
+  free(sum);
+}
+
+// Runs seeds seed..seed+n_worlds-1 in forked children, as many at once as
+// there are threads, and tiles their thumbnails into rgbgene-sheet.png
+int run_ensemble(int n_worlds, int n_threads, int thumb) {
+  int thumb_w = thumb < world.width ? thumb : world.width;
+  int thumb_h = ((int64_t)world.height * thumb_w + world.width / 2) / world.width;
+  if (thumb_h < 1) thumb_h = 1;
+  int cols = ceil(sqrt(n_worlds)), rows = (n_worlds + cols - 1) / cols;
+  int sheet_w = cols * (thumb_w + ENSEMBLE_GAP) - ENSEMBLE_GAP;
+  int sheet_h = rows * (thumb_h + ENSEMBLE_GAP) - ENSEMBLE_GAP;
+  size_t sheet_size = (size_t)sheet_w * sheet_h * sizeof(uint16_t);
+  uint16_t *sheet = mmap(NULL, sheet_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (sheet == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+
+  // Fewer worlds than cores: split the cores between them
+  int n_jobs = n_worlds < n_threads ? n_worlds : n_threads;
+  int world_threads = n_threads / n_jobs;
+  uint64_t base_seed = world.engine.seed;
+  double start = time_now();
+  int next = 0, running = 0, failed = 0;
+  printf("ensemble: %d worlds, %d at a time, %d threads each\n", n_worlds, n_jobs, world_threads);
+
+  while (next < n_worlds || running > 0) {
+    if (next < n_worlds && running < n_jobs) {
+      int index = next++;
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("fork");
+        next = n_worlds;
+        failed++;
+        continue;
+      }
+      if (pid == 0) {
+        double world_start_time = time_now();
+        world.engine.seed = base_seed + index;
+        world_init();
+        world_seed();
+        stats_scan();
+        world_start(world_threads);
+        world_join();
+
+        uint64_t occupied = world.stats.occupied;
+        uint16_t *cell = sheet + (index % cols) * (thumb_w + ENSEMBLE_GAP) + (size_t)(index / cols) * (thumb_h + ENSEMBLE_GAP) * sheet_w;
+        world_thumbnail(cell, thumb_w, thumb_h, sheet_w);
+
+        char path[64];
+        snprintf(path, sizeof(path), "rgbgene-%lu.png", world.engine.seed);
+        struct png_export *png = png_new(path, thumb_w, thumb_h);
+        for (int y = 0; y < thumb_h; y++)
+          memcpy((uint16_t *)png->pixels + (size_t)y * thumb_w, cell + (size_t)y * sheet_w, thumb_w * sizeof(uint16_t));
+        bool ok = png_write(png);
+        printf("seed %-6lu occupied %6.2f%%  hash %016lx  %.3fs\n", world.engine.seed,
+            100.0 * occupied / (world.width * world.height), world_hash(), time_now() - world_start_time);
+        fflush(stdout);
+        _exit(ok ? 0 : 1);
+      }
+      running++;
+      continue;
+    }
+    int status;
+    if (wait(&status) < 0) break;
+    running--;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failed++;
+  }
+
+  struct png_export *png = png_new("rgbgene-sheet.png", sheet_w, sheet_h);
+  memcpy(png->pixels, sheet, sheet_size);
+  bool ok = png_write(png);
+  png_free(png);
+  munmap(sheet, sheet_size);
+  printf("ensemble: %d worlds in %.3fs, %d failed, sheet %dx%d of seeds %lu..%lu in rows of %d\n", n_worlds,
+      time_now() - start, failed, sheet_w, sheet_h, base_seed, base_seed + n_worlds - 1, cols);
+  return ok && failed == 0 ? 0 : 1;
+}
+
+// Timeline scrubbing. The bar at the bottom (or Left/Right, with Shift a
+// whole delta block at a time) picks a step, and the view shows the grid
+// rebuilt from the last keyframe at or before it plus the delta records up
+// to it. Seeking forward carries on from the current grid, so dragging only
+// decodes what it passes over. End goes back to the live world. The file
+// is rescanned every frame for blocks the writer has finished
+static struct scrub {
+  FILE *in;
+  struct timeline_header hdr;
+  long scanned; // offset of the first block not indexed yet
+  struct scrub_block {
+    struct timeline_block b;
+    long offset; // of the payload
+  } *blocks;
+  int n_blocks, cap_blocks;
+  uint64_t last_step;
+  bool active, dragging, replay;
+  uint64_t target, at; // at is the step `snap` shows, UINT64_MAX before the first seek
+  struct snapshot snap;
+  uint64_t seq;
+  uint16_t *frame; // keyframe being loaded
+  uint8_t *packed, *raw;
+  size_t packed_cap, raw_cap, frame_cap;
+  int raw_block, raw_record; // delta block in raw, and the record at raw_pos
+  size_t raw_pos;
+  double seek_time;
+} scrub = {
+  .target = UINT64_MAX,
+  .at = UINT64_MAX,
+  .raw_block = -1,
+  .seq = 1ull << 62, // apart from the live snapshots, so switching refreshes every tile
+};
+
+// With `replay` the world takes the size of the recorded one
+bool scrub_open(const char *path, bool replay) {
+  scrub.in = fopen(path, "rb");
+  if (scrub.in == NULL) {
+    perror(path);
+    return false;
+  }
+  if (fread(&scrub.hdr, sizeof(scrub.hdr), 1, scrub.in) != 1 || memcmp(scrub.hdr.magic, TIMELINE_MAGIC, 8) || scrub.hdr.version != TIMELINE_VERSION) {
+    fprintf(stderr, "%s: not a timeline\n", path);
+    return false;
+  }
+  if (replay) {
+    world.width = scrub.hdr.width;
+    world.height = scrub.hdr.height;
+    world.engine.seed = scrub.hdr.seed;
+    world.engine.step = scrub.hdr.start_step;
+  }
+  scrub.replay = scrub.active = replay;
+  scrub.scanned = sizeof(scrub.hdr);
+  scrub.last_step = scrub.hdr.start_step;
+  return true;
+}
+
+void scrub_scan(void) {
+  fseek(scrub.in, 0, SEEK_END);
+  long size = ftell(scrub.in);
+  while (scrub.scanned + (long)sizeof(struct timeline_block) <= size) {
+    struct timeline_block b;
+    fseek(scrub.in, scrub.scanned, SEEK_SET);
+    if (fread(&b, sizeof(b), 1, scrub.in) != 1) break;
+    if (scrub.scanned + (long)sizeof(b) + b.size > size) break;
+    if (scrub.n_blocks == scrub.cap_blocks) {
+      scrub.cap_blocks = scrub.cap_blocks ? scrub.cap_blocks * 2 : 256;
+      scrub.blocks = realloc(scrub.blocks, scrub.cap_blocks * sizeof(struct scrub_block));
+    }
+    scrub.blocks[scrub.n_blocks++] = (struct scrub_block) { b, scrub.scanned + sizeof(b) };
+    if (b.step + b.n_steps > scrub.last_step) scrub.last_step = b.step + b.n_steps;
+    scrub.scanned += sizeof(b) + b.size;
+  }
+}
+
+// Inflates block i into *dst
+bool scrub_read(int i, void *dst) {
+  struct scrub_block *sb = &scrub.blocks[i];
+  if (sb->b.size > scrub.packed_cap) {
+    scrub.packed_cap = sb->b.size;
+    scrub.packed = realloc(scrub.packed, scrub.packed_cap);
+  }
+  uLongf n = sb->b.raw_size;
+  fseek(scrub.in, sb->offset, SEEK_SET);
+  return fread(scrub.packed, 1, sb->b.size, scrub.in) == sb->b.size &&
+    uncompress(dst, &n, scrub.packed, sb->b.size) == Z_OK && n == sb->b.raw_size;
+}
+
+bool scrub_keyframe(int i) {
+  size_t grid_size = (size_t)world.width * world.height * sizeof(uint16_t);
+  if (scrub.blocks[i].b.raw_size != grid_size) return false;
+  if (scrub.frame == NULL)
+    scrub.frame = world_alloc(grid_size);
+  if (!scrub_read(i, scrub.frame)) return false;
+  for (int tile = 0; tile < world.n_tiles; tile++) {
+    int x0, y0, tw, th;
+    tile_bounds(tile, &x0, &y0, &tw, &th);
+    for (int y = 0; y < th; y++)
+      memcpy(scrub.snap.tiles[tile] + y * tw, scrub.frame + x0 + (size_t)(y0 + y) * world.width, tw * sizeof(uint16_t));
+    scrub.snap.tile_seq[tile] = scrub.seq;
+  }
+  scrub.at = scrub.blocks[i].b.step;
+  return true;
+}
+
+static inline void scrub_set(uint64_t cell, uint16_t color) {
+  int x = cell % world.width, y = cell / world.width, tile = x / TILE_SIZE + (y / TILE_SIZE) * world.tiles_x;
+  int tw = world.width - x / TILE_SIZE * TILE_SIZE < TILE_SIZE ? world.width - x / TILE_SIZE * TILE_SIZE : TILE_SIZE;
+  scrub.snap.tiles[tile][x % TILE_SIZE + (y % TILE_SIZE) * tw].color = color;
+  scrub.snap.tile_seq[tile] = scrub.seq;
+}
+
+// Applies the records of delta block i from scrub.at up to `target`
+bool scrub_deltas(int i, uint64_t target) {
+  struct timeline_block *b = &scrub.blocks[i].b;
+  if (scrub.raw_block != i) {
+    if (b->raw_size > scrub.raw_cap) {
+      scrub.raw_cap = b->raw_size;
+      scrub.raw = realloc(scrub.raw, scrub.raw_cap);
+    }
+    scrub.raw_block = -1;
+    if (!scrub_read(i, scrub.raw)) return false;
+    scrub.raw_block = i;
+    scrub.raw_record = 0;
+    scrub.raw_pos = 0;
+  }
+  if (b->step + scrub.raw_record > scrub.at) {
+    scrub.raw_record = 0;
+    scrub.raw_pos = 0;
+  }
+
+  const uint8_t *p = scrub.raw + scrub.raw_pos, *end = scrub.raw + b->raw_size;
+  uint64_t n_cells = (uint64_t)world.width * world.height;
+  while (scrub.raw_record < (int)b->n_steps && b->step + scrub.raw_record < target) {
+    bool apply = b->step + scrub.raw_record >= scrub.at;
+    uint64_t n_runs, cell = 0, gap, len;
+    if ((p = varint_get(p, end, &n_runs)) == NULL) return false;
+    for (uint64_t r = 0; r < n_runs; r++) {
+      if ((p = varint_get(p, end, &gap)) == NULL || (p = varint_get(p, end, &len)) == NULL) return false;
+      cell += gap;
+      if (cell + len > n_cells || (size_t)(end - p) < len * 2) return false;
+      for (uint64_t j = 0; apply && j < len; j++)
+        scrub_set(cell + j, p[j * 2] | p[j * 2 + 1] << 8);
+      p += len * 2;
+      cell += len;
+    }
+    scrub.raw_record++;
+    scrub.raw_pos = p - scrub.raw;
+    if (apply) scrub.at = b->step + scrub.raw_record;
+  }
+  return true;
+}
+
+// Brings scrub.snap to `target`, or as close as the file goes. False while
+// there is nothing to show
+bool scrub_seek(uint64_t target) {
+  int k = -1;
+  for (int i = 0; i < scrub.n_blocks; i++)
+    if (scrub.blocks[i].b.type == TIMELINE_KEYFRAME && scrub.blocks[i].b.step <= target) k = i;
+  if (k < 0) return scrub.at != UINT64_MAX;
+  if (target == scrub.at) return true;
+
+  double start = time_now();
+  if (scrub.snap.tiles == NULL) {
+    scrub.snap.tile_seq = calloc(world.n_tiles, sizeof(uint64_t));
+    scrub.snap.tiles = world_alloc((size_t)world.n_tiles * sizeof(*scrub.snap.tiles));
+  }
+  scrub.seq++;
+  if (scrub.at == UINT64_MAX || scrub.at > target || scrub.at < scrub.blocks[k].b.step) {
+    if (!scrub_keyframe(k)) {
+      scrub.at = UINT64_MAX;
+      return false;
+    }
+  }
+  for (int i = k + 1; i < scrub.n_blocks && scrub.at < target; i++) {
+    struct timeline_block *b = &scrub.blocks[i].b;
+    if (b->type != TIMELINE_DELTAS || b->step + b->n_steps <= scrub.at) continue;
+    if (b->step > scrub.at || !scrub_deltas(i, target)) break;
+  }
+  scrub.snap.step = scrub.at;
+  scrub.seek_time = time_now() - start;
+  return true;
+}
+
+Rectangle scrub_bar(void) {
+  return (Rectangle) { 8, GetScreenHeight() - 50, GetScreenWidth() - 16, 8 };
+}
+
+void scrub_input(void) {
+  Rectangle bar = scrub_bar(), grab = { bar.x, bar.y - 4, bar.width, bar.height + 8 };
+  uint64_t first = scrub.hdr.start_step;
+  int stride = IsKeyDown(KEY_LEFT_SHIFT) ? TIMELINE_BLOCK : 1;
+
+  if (IsMouseButtonPressed(MOUSE_BUTTON_LEFT) && CheckCollisionPointRec(GetMousePosition(), grab))
+    scrub.dragging = scrub.active = true;
+  if (!IsMouseButtonDown(MOUSE_BUTTON_LEFT))
+    scrub.dragging = false;
+  if (!scrub.active || scrub.target > scrub.last_step)
+    scrub.target = scrub.last_step;
+  if (scrub.dragging) {
+    float t = fminf(1.0f, fmaxf(0.0f, (GetMousePosition().x - bar.x) / bar.width));
+    scrub.target = first + llround(t * (scrub.last_step - first));
+  }
+  if (IsKeyPressed(KEY_LEFT)) {
+    scrub.active = true;
+    scrub.target = scrub.target > first + stride ? scrub.target - stride : first;
+  }
+  if (IsKeyPressed(KEY_RIGHT) && scrub.active)
+    scrub.target = scrub.target + stride < scrub.last_step ? scrub.target + stride : scrub.last_step;
+  if (IsKeyPressed(KEY_END) && !scrub.replay)
+    scrub.active = false;
+}
+
+void scrub_draw(void) {
+  Rectangle bar = scrub_bar();
+  uint64_t first = scrub.hdr.start_step, span = scrub.last_step > first ? scrub.last_step - first : 1;
+  uint64_t shown = scrub.active && scrub.at != UINT64_MAX ? scrub.at : scrub.last_step;
+  DrawRectangleRec(bar, Fade(BLACK, 0.7f));
+  DrawRectangle(bar.x, bar.y, bar.width * (shown - first) / span, bar.height, scrub.active ? ORANGE : Fade(SKYBLUE, 0.6f));
+  DrawRectangleLinesEx(bar, 1, GRAY);
+  DrawText(scrub.active ? TextFormat("timeline: step %lu of %lu..%lu, seek %.1f ms%s", shown, first, scrub.last_step,
+        scrub.seek_time * 1e3, scrub.replay ? "" : " (End for live)") : TextFormat("timeline: live, %lu steps recorded", scrub.last_step - first),
+      bar.x, bar.y - 12, 10, scrub.active ? ORANGE : WHITE);
+}
+
+// Zoom/pan viewer. Level 0 is the front snapshot, every further level halves
+// the previous one. Levels are only updated where the snapshot changed: a
+// changed tile recomputes its own footprint on each level, and each level
+// uploads just the tile rows that changed, and only while it's on screen
+static struct view {
+  float zoom; // screen pixels per world pixel
+  Vector2 center; // world coordinates
+  int n_levels, level;
+  struct level {
+    int width, height;
+    uint16_t *pixels; // NULL on level 0
+    Texture2D tex;
+    uint8_t *dirty_rows; // per tile row
+  } levels[MAX_LEVELS];
+  uint64_t *seen_seq;
+  double upload_time;
+} view;
+
+static inline uint16_t rgb565_avg4(uint16_t a, uint16_t b, uint16_t c, uint16_t d) {
+  int r = (a >> 11) + (b >> 11) + (c >> 11) + (d >> 11);
+  int g = ((a >> 5) & 63) + ((b >> 5) & 63) + ((c >> 5) & 63) + ((d >> 5) & 63);
+  int bl = (a & 31) + (b & 31) + (c & 31) + (d & 31);
+  return ((r + 2) >> 2) << 11 | ((g + 2) >> 2) << 5 | ((bl + 2) >> 2);
+}
+
+static inline uint16_t snapshot_pixel(struct snapshot *snap, int x, int y) {
+  int tile = x / TILE_SIZE + (y / TILE_SIZE) * world.tiles_x;
+  int tw = world.width - (x / TILE_SIZE) * TILE_SIZE < TILE_SIZE ? world.width - (x / TILE_SIZE) * TILE_SIZE : TILE_SIZE;
+  return snap->tiles[tile][(x % TILE_SIZE) + (y % TILE_SIZE) * tw].color;
+}
+
+static inline uint16_t level_pixel(struct snapshot *snap, int l, int x, int y) {
+  struct level *lv = &view.levels[l];
+  if (x >= lv->width) x = lv->width - 1;
+  if (y >= lv->height) y = lv->height - 1;
+  return l == 0 ? snapshot_pixel(snap, x, y) : lv->pixels[x + (size_t)y * lv->width];
+}
+
+void view_init(void) {
+  int w = world.width, h = world.height;
+  view.levels[0] = (struct level) { .width = w, .height = h };
+  for (view.n_levels = 1; view.n_levels < MAX_LEVELS && (w > MIP_MIN_SIZE || h > MIP_MIN_SIZE); view.n_levels++) {
+    w = (w + 1) / 2;
+    h = (h + 1) / 2;
+    view.levels[view.n_levels] = (struct level) {
+      .width = w,
+      .height = h,
+      .pixels = world_alloc((size_t)w * h * sizeof(uint16_t)),
+      .dirty_rows = calloc(world.tiles_y, 1),
+    };
+  }
+  view.seen_seq = calloc(world.n_tiles, sizeof(uint64_t));
+  view.center = (Vector2) { world.width / 2.0f, world.height / 2.0f };
+  view.zoom = fminf(1.0f, fminf((float)GetScreenWidth() / world.width, (float)GetScreenHeight() / world.height));
+}
+
+// Propagates every tile that changed in `snap` up the pyramid, returns the
+// number of pixels in those tiles
+long view_update(struct snapshot *snap) {
+  long changed = 0;
+  for (int tile = 0; tile < world.n_tiles; tile++) {
+    if (snap->tile_seq[tile] == view.seen_seq[tile]) continue;
+    view.seen_seq[tile] = snap->tile_seq[tile];
+
+    int x0, y0, tw, th;
+    tile_bounds(tile, &x0, &y0, &tw, &th);
+    changed += tw * th;
+    for (int l = 1; l < view.n_levels; l++) {
+      struct level *lv = &view.levels[l];
+      int lx0 = x0 >> l, ly0 = y0 >> l, lx1 = ((x0 + tw - 1) >> l) + 1, ly1 = ((y0 + th - 1) >> l) + 1;
+      for (int y = ly0; y < ly1; y++) {
+        for (int x = lx0; x < lx1; x++) {
+          lv->pixels[x + (size_t)y * lv->width] = rgb565_avg4(
+              level_pixel(snap, l - 1, x * 2, y * 2), level_pixel(snap, l - 1, x * 2 + 1, y * 2),
+              level_pixel(snap, l - 1, x * 2, y * 2 + 1), level_pixel(snap, l - 1, x * 2 + 1, y * 2 + 1));
+        }
+      }
+      lv->dirty_rows[tile / world.tiles_x] = 1;
+    }
+  }
+  return changed;
+}
+
+// Brings the texture of level `l` up to date with the pyramid
+void view_upload(struct snapshot *snap, int l) {
+  struct level *lv = &view.levels[l];
+  if (lv->tex.id == 0) {
+    lv->tex = LoadTextureFromImage((Image) {
+      .data = lv->pixels,
+      .width = lv->width,
+      .height = lv->height,
+      .mipmaps = 1,
+      .format = PIXELFORMAT_UNCOMPRESSED_R5G6B5
+    });
+    if (lv->tex.id == 0) return;
+    if (l == 0) {
+      for (int tile = 0; tile < world.n_tiles; tile++)
+        world.snap.uploaded_seq[tile] = UINT64_MAX;
+    } else {
+      memset(lv->dirty_rows, 0, world.tiles_y);
+    }
+  }
+
+  if (l == 0) {
+    for (int tile = 0; tile < world.n_tiles; tile++) {
+      if (snap->tile_seq[tile] == world.snap.uploaded_seq[tile]) continue;
+      int x0, y0, tw, th;
+      tile_bounds(tile, &x0, &y0, &tw, &th);
+      UpdateTextureRec(lv->tex, (Rectangle) { x0, y0, tw, th }, snap->tiles[tile]);
+      world.snap.uploaded_seq[tile] = snap->tile_seq[tile];
+    }
+    return;
+  }
+
+  for (int ty = 0; ty < world.tiles_y; ty++) {
+    if (!lv->dirty_rows[ty]) continue;
+    lv->dirty_rows[ty] = 0;
+    int y0 = (ty * TILE_SIZE) >> l, y1 = (((ty + 1) * TILE_SIZE - 1) >> l) + 1;
+    if (y1 > lv->height) y1 = lv->height;
+    UpdateTextureRec(lv->tex, (Rectangle) { 0, y0, lv->width, y1 - y0 }, lv->pixels + (size_t)y0 * lv->width);
+  }
+}
+
+void view_input(void) {
+  Vector2 screen = { GetScreenWidth() / 2.0f, GetScreenHeight() / 2.0f };
+  Vector2 mouse = GetMousePosition();
+  float wheel = GetMouseWheelMove();
+
+  if (wheel != 0) {
+    Vector2 before = {
+      view.center.x + (mouse.x - screen.x) / view.zoom,
+      view.center.y + (mouse.y - screen.y) / view.zoom,
+    };
+    view.zoom *= powf(1.25f, wheel);
+    if (view.zoom > 64.0f) view.zoom = 64.0f;
+    if (view.zoom < 1.0f / (1 << (view.n_levels + 2))) view.zoom = 1.0f / (1 << (view.n_levels + 2));
+    view.center.x = before.x - (mouse.x - screen.x) / view.zoom;
+    view.center.y = before.y - (mouse.y - screen.y) / view.zoom;
+  }
+
+  if ((IsMouseButtonDown(MOUSE_BUTTON_LEFT) && !scrub.dragging) || IsMouseButtonDown(MOUSE_BUTTON_MIDDLE)) {
+    Vector2 delta = GetMouseDelta();
+    view.center.x -= delta.x / view.zoom;
+    view.center.y -= delta.y / view.zoom;
+  }
+
+  if (IsKeyPressed(KEY_HOME)) {
+    view.center = (Vector2) { world.width / 2.0f, world.height / 2.0f };
+    view.zoom = fminf(1.0f, fminf((float)GetScreenWidth() / world.width, (float)GetScreenHeight() / world.height));
+  }
+}
+
+// Draws from the finest level that is no more than 2x minified, falling
+// back to coarser levels when a texture can't be created (too big)
+void view_draw(struct snapshot *snap) {
+  int l = 0;
+  while (l + 1 < view.n_levels && view.zoom * (1 << (l + 1)) <= 1.0f) l++;
+  double start = time_now();
+  for (; l < view.n_levels; l++) {
+    view_upload(snap, l);
+    if (view.levels[l].tex.id != 0) break;
+  }
+  view.upload_time = time_now() - start;
+  if (l == view.n_levels) return;
+  view.level = l;
+
+  struct level *lv = &view.levels[l];
+  float scale = (float)lv->width / world.width;
+  Vector2 screen = { GetScreenWidth(), GetScreenHeight() };
+  Rectangle src = {
+    (view.center.x - screen.x / 2 / view.zoom) * scale,
+    (view.center.y - screen.y / 2 / view.zoom) * scale,
+    screen.x / view.zoom * scale,
+    screen.y / view.zoom * scale,
+  };
+  SetTextureFilter(lv->tex, view.zoom * (1 << l) >= 1.0f ? TEXTURE_FILTER_POINT : TEXTURE_FILTER_BILINEAR);
+  DrawTexturePro(lv->tex, src, (Rectangle) { 0, 0, screen.x, screen.y }, (Vector2) { 0, 0 }, 0.0f, WHITE);
+}
+
+// Performance overlay, toggled with H. Frame timings are averaged and the
+// lock histograms windowed over the same one second as the rates
+static struct hud {
+  bool show;
+  int frames;
+  double scan_time, upload_time, changed, tile_pixels;
+  uint64_t seen_painted;
+  struct hud_totals {
+    double scan_time, upload_time, changed, tile_pixels;
+    uint64_t wait[PERF_BUCKETS], hold[PERF_BUCKETS];
+  } totals, last;
+  uint64_t wait[PERF_BUCKETS], hold[PERF_BUCKETS];
+} hud;
+
+// `live` is the newest world snapshot, its painted count gives the pixels
+// changed since the last frame; `tile_pixels` is the area the viewer rescanned
+void hud_frame(double scan_time, long tile_pixels, struct snapshot *live) {
+  struct hud_totals *t = &hud.totals;
+  hud.frames++;
+  t->scan_time += scan_time;
+  t->upload_time += view.upload_time;
+  t->tile_pixels += tile_pixels;
+  if (live->painted > hud.seen_painted) {
+    t->changed += live->painted - hud.seen_painted;
+    hud.seen_painted = live->painted;
+  }
+  memset(t->wait, 0, sizeof(t->wait));
+  memset(t->hold, 0, sizeof(t->hold));
+  for (int i = 0, n = atomic_load(&perf.n_slots); i < n && i < PERF_SLOTS; i++) {
+    for (int b = 0; b < PERF_BUCKETS; b++) {
+      t->wait[b] += atomic_load_explicit(&perf.slots[i].wait[b], memory_order_relaxed);
+      t->hold[b] += atomic_load_explicit(&perf.slots[i].hold[b], memory_order_relaxed);
+    }
+  }
+}
+
+// Closes the one second window
+void hud_window(void) {
+  struct hud_totals *t = &hud.totals, *l = &hud.last;
+  int frames = hud.frames > 0 ? hud.frames : 1;
+  hud.scan_time = (t->scan_time - l->scan_time) / frames;
+  hud.upload_time = (t->upload_time - l->upload_time) / frames;
+  hud.changed = (t->changed - l->changed) / frames;
+  hud.tile_pixels = (t->tile_pixels - l->tile_pixels) / frames;
+  for (int b = 0; b < PERF_BUCKETS; b++) {
+    hud.wait[b] = t->wait[b] - l->wait[b];
+    hud.hold[b] = t->hold[b] - l->hold[b];
+  }
+  hud.frames = 0;
+  *l = *t;
+}
+
+// log2 nanosecond buckets as bars, with ticks at 1us, 1ms and 1s
+void hud_histogram(const char *title, const uint64_t *hist, int x, int y) {
+  uint64_t total = 0, max = 1;
+  double sum = 0;
+  for (int b = 0; b < PERF_BUCKETS; b++) {
+    total += hist[b];
+    sum += hist[b] * exp2(b - 0.5) * 1e-9;
+    if (hist[b] > max) max = hist[b];
+  }
+  DrawText(TextFormat("%s: %lu/s, ~%.3f ms/s", title, total, sum * 1e3), x, y, 10, WHITE);
+  for (int b = 0; b < PERF_BUCKETS; b++) {
+    int h = hist[b] ? 2 + 28 * log2(1 + hist[b]) / log2(1 + max) : 0;
+    DrawRectangle(x + b * 6, y + 44 - h, 5, h, b >= 20 ? ORANGE : SKYBLUE);
+  }
+  for (int b = 10; b < PERF_BUCKETS; b += 10)
+    DrawText(b == 10 ? "1us" : b == 20 ? "1ms" : "1s", x + b * 6, y + 46, 10, GRAY);
+}
+
+void hud_draw(double steps_per_sec, double grown_per_sec, double rounds_per_sec) {
+  int x = GetScreenWidth() - 208, y = 8;
+  DrawRectangle(x - 8, y - 4, 212, 212, Fade(BLACK, 0.7f));
+  DrawText(TextFormat("%.0f steps/s, %.3f Mpicks/s", rounds_per_sec, steps_per_sec * 1e-6), x, y, 10, WHITE);
+  DrawText(TextFormat("%.3f Mgrown/s", grown_per_sec * 1e-6), x, y + 12, 10, WHITE);
+  DrawText(TextFormat("scan %.3f ms, upload %.3f ms", hud.scan_time * 1e3, hud.upload_time * 1e3), x, y + 24, 10, WHITE);
+  DrawText(TextFormat("%.0f px/frame changed, %.0f tiled", hud.changed, hud.tile_pixels), x, y + 36, 10, WHITE);
+  hud_histogram("mut_world wait", hud.wait, x, y + 56);
+  hud_histogram("mut_world hold", hud.hold, x, y + 124);
+}
+
+// Population panel, toggled with P: live cells and growth per step over the
+// last PLOT_SAMPLES samples of the published stats, and the channel
+// histograms of the newest
+static struct plot {
+  bool show;
+  int n, head;
+  double last_time;
+  struct plot_sample {
+    uint64_t step;
+    int64_t occupied;
+  } samples[PLOT_SAMPLES];
+} plot;
+
+void plot_sample(struct snapshot *snap) {
+  double now = time_now();
+  struct plot_sample *last = &plot.samples[(plot.head + PLOT_SAMPLES - 1) % PLOT_SAMPLES];
+  if (plot.n > 0 && (last->step == snap->step || now - plot.last_time < PLOT_INTERVAL)) return;
+  plot.samples[plot.head] = (struct plot_sample) { snap->step, snap->stats.occupied };
+  plot.head = (plot.head + 1) % PLOT_SAMPLES;
+  if (plot.n < PLOT_SAMPLES) plot.n++;
+  plot.last_time = now;
+}
+
+static inline double plot_growth(int i) {
+  struct plot_sample *a = &plot.samples[(plot.head + PLOT_SAMPLES - plot.n + i - 1) % PLOT_SAMPLES];
+  struct plot_sample *b = &plot.samples[(plot.head + PLOT_SAMPLES - plot.n + i) % PLOT_SAMPLES];
+  return b->step > a->step ? (double)(b->occupied - a->occupied) / (b->step - a->step) : 0;
+}
+
+void plot_histogram(const char *title, const int64_t *hist, int n, Color color, int x, int y) {
+  int64_t max = 1;
+  for (int v = 0; v < n; v++)
+    if (hist[v] > max) max = hist[v];
+  DrawText(title, x, y + 10, 10, color);
+  for (int v = 0; v < n; v++) {
+    int h = hist[v] * 28 / max;
+    DrawRectangle(x + 12 + v * 184 / n, y + 28 - h, 184 / n > 1 ? 184 / n - 1 : 1, h, color);
+  }
+}
+
+void plot_draw(struct snapshot *snap) {
+  int x = GetScreenWidth() - 208, y = hud.show ? 224 : 8, gy = y + 28, gh = 48;
+  double cells = (double)world.width * world.height, max_growth = 1;
+  DrawRectangle(x - 8, y - 4, 212, 200, Fade(BLACK, 0.7f));
+  for (int i = 1; i < plot.n; i++)
+    max_growth = fmax(max_growth, plot_growth(i));
+  DrawText(TextFormat("occupied %ld (%.2f%%)", snap->stats.occupied, 100.0 * snap->stats.occupied / cells), x, y, 10, WHITE);
+  DrawText(TextFormat("growth %.0f cells/step, peak %.0f", plot.n > 1 ? plot_growth(plot.n - 1) : 0.0, max_growth), x, y + 12, 10, SKYBLUE);
+  DrawRectangleLines(x, gy, 196, gh, GRAY);
+  for (int i = 1; i < plot.n; i++) {
+    int x0 = x + (i - 1) * 196 / PLOT_SAMPLES, x1 = x + i * 196 / PLOT_SAMPLES;
+    struct plot_sample *a = &plot.samples[(plot.head + PLOT_SAMPLES - plot.n + i - 1) % PLOT_SAMPLES];
+    struct plot_sample *b = &plot.samples[(plot.head + PLOT_SAMPLES - plot.n + i) % PLOT_SAMPLES];
+    DrawLine(x0, gy + gh - a->occupied / cells * gh, x1, gy + gh - b->occupied / cells * gh, WHITE);
+    if (i > 1)
+      DrawLine(x0, gy + gh - plot_growth(i - 1) / max_growth * gh, x1, gy + gh - plot_growth(i) / max_growth * gh, SKYBLUE);
+  }
+  plot_histogram("r", snap->stats.r, 32, RED, x, gy + gh + 4);
+  plot_histogram("g", snap->stats.g, 64, GREEN, x, gy + gh + 40);
+  plot_histogram("b", snap->stats.b, 32, BLUE, x, gy + gh + 76);
+}
+
+int main(int argc, char **argv) {
+  int n_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  bool headless = false, resume = false;
+  const char *checkpoint_path = NULL, *capture_path = NULL, *shm_name = NULL, *timeline_path = NULL, *replay_path = NULL;
+  int ensemble = 0, thumb = ENSEMBLE_THUMB, procs = 0;
+  const char *stats_path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if ((!strcmp(argv[i], "-t") || !strcmp(argv[i], "--threads")) && i + 1 < argc) {
+      n_threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--headless")) {
+      headless = true;
+    } else if (!strcmp(argv[i], "--steps") && i + 1 < argc) {
+      world.engine.max_steps = strtoull(argv[++i], NULL, 0);
+    } else if (!strcmp(argv[i], "--procs") && i + 1 < argc) {
+      procs = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--ensemble") && i + 1 < argc) {
+      ensemble = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--thumb") && i + 1 < argc) {
+      thumb = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--seed") && i + 1 < argc) {
+      world.engine.seed = strtoull(argv[++i], NULL, 0);
+    } else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+      if (sscanf(argv[++i], "%dx%d", &world.width, &world.height) != 2) {
+        fprintf(stderr, "--size expects WIDTHxHEIGHT\n");
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--hugepages")) {
+      world.hugepages = true;
+    } else if (!strcmp(argv[i], "--checkpoint") && i + 1 < argc) {
+      checkpoint_path = argv[++i];
+    } else if (!strcmp(argv[i], "--resume") && i + 1 < argc) {
+      checkpoint_path = argv[++i];
+      resume = true;
+    } else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+      capture_path = argv[++i];
+    } else if (!strcmp(argv[i], "--shm") && i + 1 < argc) {
+      shm_name = argv[++i];
+    } else if (!strcmp(argv[i], "--timeline") && i + 1 < argc) {
+      timeline_path = argv[++i];
+    } else if (!strcmp(argv[i], "--keyframe-every") && i + 1 < argc) {
+      timeline.keyframe_every = strtoull(argv[++i], NULL, 0);
+    } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (!strcmp(argv[i], "--stats") && i + 1 < argc) {
+      stats_path = argv[++i];
+    } else if (!strcmp(argv[i], "--stats-every") && i + 1 < argc) {
+      stats_csv.every = strtoull(argv[++i], NULL, 0);
+    } else if (!strcmp(argv[i], "--capture-every") && i + 1 < argc) {
+      capture.every = strtoull(argv[++i], NULL, 0);
+    } else if (!strcmp(argv[i], "--capture-lossless")) {
+      capture.lossless = true;
+    } else if (!strcmp(argv[i], "--wrap")) {
+      world.engine.wrap = true;
+    } else if (!strcmp(argv[i], "--rate") && i + 1 < argc) {
+      world.engine.rate = atof(argv[++i]);
+    } else if (!strcmp(argv[i], "--rule") && i + 1 < argc) {
+      rule.path = argv[++i];
+    } else if (!strcmp(argv[i], "--engine") && i + 1 < argc && !strcmp(argv[i + 1], "random")) {
+      world.engine.mode = ENGINE_RANDOM;
+      i++;
+    } else if (!strcmp(argv[i], "--engine") && i + 1 < argc && !strcmp(argv[i + 1], "frontier")) {
+      world.engine.mode = ENGINE_FRONTIER;
+      i++;
+    } else if (!strcmp(argv[i], "--engine") && i + 1 < argc && !strcmp(argv[i + 1], "sweep")) {
+      world.engine.mode = ENGINE_SWEEP;
+      i++;
+    } else {
+      fprintf(stderr, "usage: %s [--threads N] [--procs N] [--engine random|frontier|sweep] [--seed S] [--rate STEPS/S] [--rule FILE.c] [--size WxH] [--wrap] [--hugepages] [--checkpoint FILE | --resume FILE] [--capture FILE|'|CMD' [--capture-every N] [--capture-lossless]] [--shm NAME] [--stats FILE.csv [--stats-every N]] [--timeline FILE [--keyframe-every N] | --replay FILE] [--headless --steps N [--ensemble N [--thumb W]]]\n", argv[0]);
+      return 1;
+    }
+  }
+  if (replay_path && (headless || checkpoint_path || capture_path || shm_name || timeline_path || stats_path)) {
+    fprintf(stderr, "--replay only views a timeline, it can't be combined with --headless, --checkpoint, --resume, --capture, --shm, --timeline or --stats\n");
+    return 1;
+  }
+  if (replay_path && !scrub_open(replay_path, true))
+    return 1;
+  if (world.width < 1 || world.height < 1 || (int64_t)world.width * world.height > INT32_MAX) {
+    fprintf(stderr, "bad world size %dx%d\n", world.width, world.height);
+    return 1;
+  }
+  if (checkpoint_path && !checkpoint_open(checkpoint_path, resume))
+    return 1;
+  if (n_threads < 1) n_threads = 1;
+  if (n_threads > MAX_THREADS) n_threads = MAX_THREADS;
+
+  if (headless && world.engine.max_steps == 0) {
+    fprintf(stderr, "--headless needs --steps\n");
+    return 1;
+  }
+  if (ensemble > 0 && (!headless || checkpoint_path || capture_path || shm_name || timeline_path || stats_path || thumb < 1)) {
+    fprintf(stderr, "--ensemble needs --headless and a positive --thumb, without --checkpoint, --resume, --capture, --shm, --timeline or --stats\n");
+    return 1;
+  }
+  if (procs > 0 && (checkpoint_path || capture_path || shm_name || timeline_path || stats_path || replay_path || ensemble > 0)) {
+    fprintf(stderr, "--procs can't be combined with --checkpoint, --resume, --capture, --shm, --timeline, --stats, --replay or --ensemble\n");
+    return 1;
+  }
+  if (world.engine.max_steps)
+    world.engine.max_steps += world.engine.step;
+  if (capture.every < 1) capture.every = 1;
+  if (timeline.keyframe_every < 1) timeline.keyframe_every = 1;
+  if (stats_csv.every < 1) stats_csv.every = 1;
+
+  mutate_colors_check();
+  if (rule.path && !rule_load())
+    return 1;
+  if (ensemble > 0)
+    return run_ensemble(ensemble, n_threads, thumb);
+  if (procs > 0 && !strips_start(procs, n_threads, !headless))
+    return 1;
+  world.snap.enabled = !headless || shm_name;
+  world_init();
+  // Once the leader or the strip monitor runs, the step is read off the snapshots
+  uint64_t rate_rounds = world.engine.step;
+  if (procs > 0)
+    strips_attach();
+  else if (resume)
+    world_resume();
+  else if (!replay_path)
+    world_seed();
+  if (!procs)
+    stats_scan();
+  if (capture_path && !capture_start(capture_path))
+    return 1;
+  if (shm_name && !shm_start(shm_name))
+    return 1;
+  if (timeline_path && !timeline_start(timeline_path))
+    return 1;
+  if (stats_path && !stats_start(stats_path))
+    return 1;
+
+  if (headless)
+    return run_headless(n_threads);
+
+  {
+    float fit = fminf(1.0f, fminf((float)DEFAULT_WIDTH / world.width, (float)DEFAULT_HEIGHT / world.height));
+    SetConfigFlags(FLAG_WINDOW_RESIZABLE);
+    InitWindow(world.width * fit, world.height * fit, "rgbgene");
+    SetTargetFPS(60);
+  }
+
+  if (timeline_path && !scrub_open(timeline_path, false))
+    return 1;
+  view_init();
+  if (!replay_path && !procs)
+    world_start(n_threads);
+  pool_start(n_threads);
+
+  double rate_time = time_now();
+  uint64_t rate_steps = 0, rate_grown = 0;
+  double steps_per_sec = 0, grown_per_sec = 0, rounds_per_sec = 0;
+
+  while (!WindowShouldClose()) {
+    BeginDrawing();
+
+    struct snapshot *front = world_consume(), *live = front;
+    plot_sample(live);
+    if (scrub.in) {
+      scrub_scan();
+      scrub_input();
+      if (scrub.active && scrub_seek(scrub.target))
+        front = &scrub.snap;
+    }
+    {
+      double start = time_now();
+      long tile_pixels = view_update(front);
+      hud_frame(time_now() - start, tile_pixels, live);
+    }
+    view_input();
+    rule_reload();
+
+    if (IsKeyPressed(KEY_C) && world.checkpoint) {
+      world_lock();
+      checkpoint_save();
+      world_unlock();
+    }
+
+    if (IsKeyPressed(KEY_S)) {
+      png_export_start("rgbgene.png");
+    }
+
+    // Up/Down double or halve the target rate, F toggles fast-forward
+    if (IsKeyPressed(KEY_UP) || IsKeyPressed(KEY_DOWN) || IsKeyPressed(KEY_F) || IsKeyPressed(KEY_SPACE)) {
+      pthread_mutex_lock(&world.engine.mut_pace);
+      if (IsKeyPressed(KEY_UP) && world.engine.rate > 0)
+        world.engine.rate *= 2;
+      if (IsKeyPressed(KEY_DOWN))
+        world.engine.rate = world.engine.rate > 0 ? fmax(1, world.engine.rate / 2) : exp2(floor(log2(fmax(2, rounds_per_sec))));
+      if (IsKeyPressed(KEY_F))
+        world.engine.fast_forward = !world.engine.fast_forward;
+      if (IsKeyPressed(KEY_SPACE))
+        world.engine.paused = !world.engine.paused;
+      pthread_mutex_unlock(&world.engine.mut_pace);
+      world_wake();
+    }
+
+    {
+      ClearBackground(BLACK);
+      view_draw(front);
+    }
+
+    if (IsKeyPressed(KEY_H))
+      hud.show = !hud.show;
+    if (IsKeyPressed(KEY_P))
+      plot.show = !plot.show;
+
+    {
+      double now = time_now();
+      if (now - rate_time >= 1.0) {
+        uint64_t steps = 0, grown = 0;
+        for (int i = 0; i < world.engine.n_threads; i++) {
+          steps += atomic_load_explicit(&world.engine.workers[i].n_steps, memory_order_relaxed);
+          grown += atomic_load_explicit(&world.engine.workers[i].n_grown, memory_order_relaxed);
+        }
+        steps_per_sec = (steps - rate_steps) / (now - rate_time);
+        grown_per_sec = (grown - rate_grown) / (now - rate_time);
+        if (live->step >= rate_rounds) { // nothing published yet otherwise
+          rounds_per_sec = (live->step - rate_rounds) / (now - rate_time);
+          rate_rounds = live->step;
+        }
+        hud_window();
+        rate_steps = steps;
+        rate_grown = grown;
+        rate_time = now;
+      }
+      DrawText(TextFormat("%d threads  %.3f Mcells/s  %.3f Mgrown/s", world.engine.n_threads, steps_per_sec * 1e-6, grown_per_sec * 1e-6), 8, 8, 10, WHITE);
+      DrawText(TextFormat("snapshots: %lu published, %lu skipped, %lu reused",
+            atomic_load(&world.snap.n_published), atomic_load(&world.snap.n_skipped), world.snap.n_reused), 8, 20, 10, WHITE);
+      if (hud.show)
+        hud_draw(steps_per_sec, grown_per_sec, rounds_per_sec);
+      if (plot.show)
+        plot_draw(live);
+      DrawText(TextFormat("zoom %.3fx  mip level %d/%d", view.zoom, view.level, view.n_levels - 1), 8, GetScreenHeight() - 18, 10, WHITE);
+      pthread_mutex_lock(&world.engine.mut_pace);
+      bool parked = world.engine.parked;
+      pthread_mutex_unlock(&world.engine.mut_pace);
+      DrawText(TextFormat("pace: %s%s%s", world.engine.rate > 0 ? TextFormat("%g of %.0f steps/s", world.engine.rate, rounds_per_sec) : TextFormat("unthrottled, %.0f steps/s", rounds_per_sec),
+            world.engine.fast_forward ? ", fast-forward" : "", parked ? (world.engine.paused ? ", paused" : ", saturated") : ""),
+          8, GetScreenHeight() - 30, 10, parked ? YELLOW : WHITE);
+      if (atomic_load(&export_busy))
+        DrawText("saving rgbgene.png...", 8, 32, 10, YELLOW);
+      if (capture.out) {
+        pthread_mutex_lock(&capture.mut);
+        int queued = capture.n;
+        pthread_mutex_unlock(&capture.mut);
+        DrawText(TextFormat("capture: %lu frames, %lu dropped, %lu stalls, queue %d/%d",
+              atomic_load(&capture.n_written), atomic_load(&capture.n_dropped), atomic_load(&capture.n_stalls),
+              queued, CAPTURE_QUEUE), 8, 44, 10, queued == CAPTURE_QUEUE ? RED : WHITE);
+      }
+      if (timeline.out) {
+        pthread_mutex_lock(&timeline.mut);
+        int queued = timeline.n;
+        pthread_mutex_unlock(&timeline.mut);
+        DrawText(TextFormat("timeline: %lu rounds, %.1f MB, %lu stalls, queue %d/%d",
+              atomic_load(&timeline.n_rounds), atomic_load(&timeline.n_bytes) / 1e6, atomic_load(&timeline.n_stalls),
+              queued, TIMELINE_QUEUE), 8, 56, 10, queued == TIMELINE_QUEUE ? RED : WHITE);
+      }
+      if (scrub.in)
+        scrub_draw();
+    }
+    EndDrawing();
+  }
+
+  if (world.checkpoint || capture.out || shm.hdr || timeline.out || stats_csv.out) {
+    world_lock();
+    if (world.checkpoint) checkpoint_save();
+    capture_stop();
+    shm_stop();
+    timeline_stop();
+    stats_stop();
   }
+  strips_stop();
 }
 
 Color color_565rgb(union color_rgb565 v) {